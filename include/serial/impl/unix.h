@@ -41,6 +41,7 @@
 #define SERIAL_IMPL_UNIX_H
 
 #include "serial/serial.h"
+#include "serial/impl/uring.h"
 
 #include <pthread.h>
 
@@ -86,18 +87,42 @@ public:
   size_t
   available ();
 
+  size_t
+  available (std::error_code &ec) noexcept;
+
   bool
   waitReadable (uint32_t timeout);
 
+  bool
+  waitReadable (uint32_t timeout, std::error_code &ec) noexcept;
+
   void
   waitByteTimes (size_t count);
 
   size_t
   read (uint8_t *buf, size_t size = 1);
 
+  size_t
+  read (uint8_t *buf, size_t size, std::error_code &ec) noexcept;
+
   size_t
   write (const uint8_t *data, size_t length);
 
+  size_t
+  write (const uint8_t *data, size_t length, std::error_code &ec) noexcept;
+
+  size_t
+  writeAsync (const uint8_t *data, size_t length, std::error_code &ec) noexcept;
+
+  size_t
+  writePending () noexcept;
+
+  bool
+  takeWriteError (std::error_code &ec) noexcept;
+
+  bool
+  waitWriteComplete (uint32_t timeout, std::error_code &ec) noexcept;
+
   void
   flush ();
 
@@ -122,6 +147,12 @@ public:
   bool
   waitForChange ();
 
+  bool
+  startModemMonitor (const ModemCallback &callback);
+
+  void
+  stopModemMonitor ();
+
   bool
   getCTS ();
 
@@ -134,6 +165,9 @@ public:
   bool
   getCD ();
 
+  int
+  getFd () const;
+
   void
   setPort (const string &port);
 
@@ -176,6 +210,18 @@ public:
   flowcontrol_t
   getFlowcontrol () const;
 
+  void
+  setLowLatency (bool enabled);
+
+  bool
+  getLowLatency () const;
+
+  bool
+  setIoUring (bool enabled);
+
+  bool
+  getIoUring () const;
+
   void
   readLock ();
 
@@ -188,8 +234,31 @@ public:
   void
   writeUnlock ();
 
+  bool
+  readLock (std::error_code &ec) noexcept;
+
+  void
+  readUnlock (std::error_code &ec) noexcept;
+
+  bool
+  writeLock (std::error_code &ec) noexcept;
+
+  void
+  writeUnlock (std::error_code &ec) noexcept;
+
 protected:
   void reconfigurePort ();
+  void throwError (const std::error_code &ec, const char *what);
+
+  static void *txThread (void *arg);
+  void txLoop ();
+  void txStop ();
+  bool txWaitEmpty (MillisecondTimer *timer, std::error_code &ec) noexcept;
+  void applyLowLatency ();
+  void applyWriteTimeout ();
+
+  static void *modemThread (void *arg);
+  void modemLoop ();
 
 private:
   string port_;               // Path to the file descriptor
@@ -208,10 +277,39 @@ private:
   stopbits_t stopbits_;       // Stop Bits
   flowcontrol_t flowcontrol_; // Flow Control
 
+  bool low_latency_;          // Low latency profile requested
+  bool low_latency_set_;      // ASYNC_LOW_LATENCY was changed by us
+  string rx_trig_path_;       // sysfs rx_trig_bytes of the port, if any
+  string rx_trig_saved_;      // rx_trig_bytes before the profile was applied
+
   // Mutex used to lock the read functions
   pthread_mutex_t read_mutex;
   // Mutex used to lock the write functions
   pthread_mutex_t write_mutex;
+
+  // Non-blocking write queue: bytes the kernel TX buffer could not take
+  // yet, fed to the fd by tx_thread_ as room frees up.
+  static const size_t tx_limit_ = 65536;
+  pthread_t tx_thread_;
+  bool tx_running_;
+  bool tx_stop_;
+  pthread_mutex_t tx_mutex_;
+  pthread_cond_t tx_cond_;        // queue not empty, or stop requested
+  pthread_cond_t tx_empty_cond_;  // queue flushed into the kernel, or failed
+  std::vector<uint8_t> tx_queue_;
+  size_t tx_head_;
+  std::error_code tx_error_;      // failure seen by tx_thread_, reported once
+
+  // Modem status monitor, woken from TIOCMIWAIT by a signal to stop.
+  pthread_t modem_thread_;
+  bool modem_running_;
+  std::atomic<bool> modem_stop_;
+  std::atomic<bool> modem_exited_;
+  ModemCallback modem_callback_;
+
+  // io_uring transport; when attached it owns all reads and writes on fd_.
+  bool use_uring_;            // Backend requested
+  UringChannel *uring_;       // Attached channel, NULL if unavailable
 };
 
 }
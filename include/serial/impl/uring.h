@@ -0,0 +1,134 @@
+/*!
+ * \file serial/impl/uring.h
+ *
+ * \section DESCRIPTION
+ *
+ * io_uring transport used by the unix implementation when the io_uring
+ * backend is enabled. Linux only; elsewhere UringChannel::open always
+ * returns NULL and the select based path is used.
+ */
+
+#ifndef SERIAL_IMPL_URING_H
+#define SERIAL_IMPL_URING_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <system_error>
+
+namespace serial {
+
+class UringRing;
+
+/*!
+ * One open port attached to the process-wide io_uring.
+ *
+ * Every channel shares a single ring. A read into the channel's slot of the
+ * registered receive buffer is kept posted at all times; completed bytes are
+ * moved to an internal buffer. There is no completion thread: waitReadable()
+ * and waitWritten() reap the ring themselves, so the thread waiting for data
+ * is the one woken, and available(), read() and the write calls pick up
+ * completions already posted without a system call. Writes are queued and
+ * submitted as one batch at a time, each linked to a timeout derived from
+ * the port's write timeout.
+ */
+class UringChannel {
+public:
+  /*! Attaches fd to the shared ring, creating it on first use. Returns NULL
+   *  if the kernel or the headers lack the needed io_uring operations, or if
+   *  all receive slots are taken. */
+  static UringChannel *open (int fd);
+
+  /*! Cancels outstanding requests and waits for their completions. */
+  ~UringChannel ();
+
+  size_t
+  available (std::error_code &ec);
+
+  /*! Copies up to size received bytes without blocking. */
+  size_t
+  read (uint8_t *buf, size_t size, std::error_code &ec);
+
+  bool
+  waitReadable (uint32_t timeout_ms, std::error_code &ec);
+
+  /*! Drops received bytes not yet read. */
+  void
+  flushInput ();
+
+  /*! Timeout linked to each write submission: constant_ms plus
+   *  per_byte_us for every byte in the batch. */
+  void
+  setWriteTimeout (uint32_t constant_ms, uint32_t per_byte_us);
+
+  /*! Queues all of data, or nothing if it does not fit, and returns at
+   *  once. A timed out or failed write is reported by the next call, by
+   *  waitWritten or by takeError. */
+  size_t
+  write (const uint8_t *data, size_t length, std::error_code &ec);
+
+  /*! Reports and clears a failed write. */
+  bool
+  takeError (std::error_code &ec);
+
+  /*! Waits until every queued byte has been handed to the driver. */
+  bool
+  waitWritten (uint32_t timeout_ms, std::error_code &ec);
+
+  /*! Bytes queued or in flight. */
+  size_t
+  writePending ();
+
+  /*! Total bytes handed to the driver since the channel was opened. */
+  uint64_t
+  bytesWritten ();
+
+  /*! Completion of one of this channel's requests, called by whichever
+   *  thread is reaping the ring. */
+  void
+  onComplete (unsigned op, int res);
+
+private:
+  UringChannel (UringRing *ring, int fd, int slot);
+  UringChannel (const UringChannel &);
+  UringChannel &operator= (const UringChannel &);
+
+  void postRead ();
+  void postWrite (bool poll_first);
+  void failWrite (const std::error_code &ec);
+
+  UringRing *ring_;
+  int fd_;
+  int slot_;
+
+  // Same layout as the kernel's __kernel_timespec.
+  struct KernelTimespec {
+    int64_t tv_sec;
+    int64_t tv_nsec;
+  };
+
+  pthread_mutex_t mutex_;
+  int inflight_;                // submitted requests without completion
+  bool closing_;
+
+  std::vector<uint8_t> rx_;
+  size_t rx_head_;
+  bool read_posted_;
+  int poll_failures_;           // consecutive failed read polls
+  std::error_code rx_error_;
+
+  std::vector<uint8_t> tx_pending_;   // queued behind the batch in flight
+  std::vector<uint8_t> tx_batch_;     // batch owned by the kernel
+  size_t tx_offset_;
+  bool write_posted_;
+  std::error_code tx_error_;
+  uint64_t tx_written_;
+  uint32_t write_constant_ms_;
+  uint32_t write_per_byte_us_;
+  KernelTimespec write_timeout_;  // read by the linked timeout request
+};
+
+} // namespace serial
+
+#endif // SERIAL_IMPL_URING_H
@@ -43,6 +43,9 @@
 #include <sstream>
 #include <exception>
 #include <stdexcept>
+#include <atomic>
+#include <system_error>
+#include <functional>
 #include <serial/v8stdint.h>
 
 #define THROW(exceptionClass, message) throw exceptionClass(__FILE__, \
@@ -89,6 +92,49 @@ typedef enum {
   flowcontrol_hardware
 } flowcontrol_t;
 
+/*!
+ * Modem status lines, as reported by the modem monitor.
+ */
+typedef enum {
+  modem_cts = 0x01,
+  modem_dsr = 0x02,
+  modem_ri = 0x04,
+  modem_cd = 0x08
+} modemline_t;
+
+/*!
+ * A change of the modem status lines seen by the modem monitor.
+ */
+struct ModemEvent {
+  /*! modemline_t bits asserted after the change. */
+  uint32_t lines;
+  /*! modemline_t bits that had at least one edge since the previous event,
+   *  including pulses too short to show up in lines. 0 for the initial
+   *  event sent when the monitor starts. */
+  uint32_t changed;
+  /*! CLOCK_MONOTONIC time the change was picked up, in microseconds. */
+  uint64_t timestamp_us;
+};
+
+typedef std::function<void (const ModemEvent &)> ModemCallback;
+
+/*!
+ * A non-owning view of a writable byte range, standing in for
+ * std::span<uint8_t> until the library moves past C++17.
+ */
+struct byte_span {
+  uint8_t *data;
+  size_t size;
+
+  byte_span (uint8_t *data_, size_t size_) : data(data_), size(size_) {}
+
+  template <size_t N>
+  byte_span (uint8_t (&array)[N]) : data(array), size(N) {}
+
+  byte_span (std::vector<uint8_t> &vector)
+    : data(vector.empty () ? NULL : &vector[0]), size(vector.size ()) {}
+};
+
 /*!
  * Structure for setting the timeout of the serial port, times are
  * in milliseconds.
@@ -113,6 +159,52 @@ struct Timeout {
     return Timeout(max(), timeout, 0, timeout, 0);
   }
 
+  /*!
+   * Time in nanoseconds one character occupies on the line: start bit,
+   * data bits, parity bit if any, and stop bits.
+   */
+  static uint32_t byteTimeNs(uint32_t baudrate,
+                             bytesize_t bytesize = eightbits,
+                             parity_t parity = parity_none,
+                             stopbits_t stopbits = stopbits_one) {
+    if (baudrate == 0) {
+      return 0;
+    }
+    // Counted in half bits so that 1.5 stop bits stays exact.
+    uint64_t half_bits = 2 * (1 + static_cast<uint64_t> (bytesize)
+                              + (parity == parity_none ? 0 : 1));
+    half_bits += stopbits == stopbits_one ? 2
+               : stopbits == stopbits_two ? 4 : 3;
+    return static_cast<uint32_t> (half_bits * 500000000ULL / baudrate);
+  }
+
+  /*!
+   * Generates a Timeout from the line rate instead of fixed multipliers.
+   *
+   * A read or write of N bytes may take turnaround_ms plus N times the byte
+   * time scaled by margin_percent. turnaround_ms is the allowance for the
+   * other end and the scheduler (FIFO thresholds, firmware pauses between
+   * chunks); the per-byte part is what the bytes themselves need on the
+   * wire. At 460800 8N1 a 4 KiB transfer gets turnaround_ms + 180 ms
+   * rather than seconds.
+   *
+   * \param margin_percent Slack on the wire time, 200 allows twice the
+   * nominal byte time.
+   */
+  static Timeout fromBaudrate(uint32_t baudrate, uint32_t turnaround_ms,
+                              bytesize_t bytesize = eightbits,
+                              parity_t parity = parity_none,
+                              stopbits_t stopbits = stopbits_one,
+                              uint32_t margin_percent = 200) {
+    uint64_t ns = static_cast<uint64_t> (
+        byteTimeNs(baudrate, bytesize, parity, stopbits)) * margin_percent / 100;
+    uint32_t per_byte_us = static_cast<uint32_t> ((ns + 999) / 1000);
+    Timeout timeout(max(), turnaround_ms, 0, turnaround_ms, 0);
+    timeout.read_timeout_multiplier_us = per_byte_us;
+    timeout.write_timeout_multiplier_us = per_byte_us;
+    return timeout;
+  }
+
   /*! Number of milliseconds between bytes received to timeout on. */
   uint32_t inter_byte_timeout;
   /*! A constant number of milliseconds to wait after calling read. */
@@ -127,6 +219,13 @@ struct Timeout {
    *  calling write.
    */
   uint32_t write_timeout_multiplier;
+  /*! Like read_timeout_multiplier but in microseconds per byte, for line
+   *  rates where a byte takes well under a millisecond. Added on top of
+   *  the millisecond terms.
+   */
+  uint32_t read_timeout_multiplier_us;
+  /*! Like write_timeout_multiplier but in microseconds per byte. */
+  uint32_t write_timeout_multiplier_us;
 
   explicit Timeout (uint32_t inter_byte_timeout_=0,
                     uint32_t read_timeout_constant_=0,
@@ -137,7 +236,9 @@ struct Timeout {
     read_timeout_constant(read_timeout_constant_),
     read_timeout_multiplier(read_timeout_multiplier_),
     write_timeout_constant(write_timeout_constant_),
-    write_timeout_multiplier(write_timeout_multiplier_)
+    write_timeout_multiplier(write_timeout_multiplier_),
+    read_timeout_multiplier_us(0),
+    write_timeout_multiplier_us(0)
   {}
 };
 
@@ -219,6 +320,11 @@ public:
   size_t
   available ();
 
+  /*! Non-throwing available(); on failure ec holds the errno (system
+   * category) and 0 is returned. */
+  size_t
+  available (std::error_code &ec) noexcept;
+
   /*! Block until there is serial data to read or read_timeout_constant
    * number of milliseconds have elapsed. The return value is true when
    * the function exits with the port in a readable state, false otherwise
@@ -226,6 +332,11 @@ public:
   bool
   waitReadable ();
 
+  /*! Non-throwing waitReadable() with an explicit timeout in milliseconds.
+   * A timeout returns false with ec cleared. */
+  bool
+  waitReadable (uint32_t timeout_ms, std::error_code &ec) noexcept;
+
   /*! Block for a period of time corresponding to the transmission time of
    * count characters at present serial settings. This may be used in con-
    * junction with waitReadable to read larger blocks of data from the
@@ -264,7 +375,26 @@ public:
   size_t
   read (uint8_t *buffer, size_t size);
 
+  /*! Non-throwing read for hot loops.
+   *
+   * Behaves like read(uint8_t*, size_t), but reports failures through ec
+   * instead of exceptions, so no unwinding or exception allocation happens
+   * on the timeout or disconnect path. A timeout is not an error: fewer
+   * bytes than requested are returned and ec is cleared. Otherwise ec is
+   *  * an errno value in std::system_category() for failed system calls,
+   *  * std::errc::bad_file_descriptor if the port is not open,
+   *  * std::errc::no_such_device if the device reports readiness but
+   *    returns no data (disconnected).
+   * Bytes read before the failure are still returned.
+   */
+  size_t
+  read (uint8_t *buffer, size_t size, std::error_code &ec) noexcept;
+
   /*! Read a given amount of bytes from the serial port into a give buffer.
+   *
+   * The bytes are appended to the vector in place: it is grown by size,
+   * read into directly and shrunk back to what was actually read, so no
+   * temporary buffer is allocated when the capacity suffices.
    *
    * \param buffer A reference to a std::vector of uint8_t.
    * \param size A size_t defining how many bytes to be read.
@@ -278,7 +408,23 @@ public:
   size_t
   read (std::vector<uint8_t> &buffer, size_t size = 1);
 
+  /*! Read up to buffer.size bytes from the serial port into a byte span.
+   *
+   * \param buffer A byte_span over caller-owned memory.
+   *
+   * \return A size_t representing the number of bytes read as a result of the
+   *         call to read.
+   *
+   * \throw serial::PortNotOpenedException
+   * \throw serial::SerialException
+   */
+  size_t
+  read (byte_span buffer);
+
   /*! Read a given amount of bytes from the serial port into a give buffer.
+   *
+   * Like the vector overload, the bytes are read directly into the
+   * string's tail.
    *
    * \param buffer A reference to a std::string.
    * \param size A size_t defining how many bytes to be read.
@@ -309,6 +455,12 @@ public:
    *
    * Reads from the serial port until a single line has been read.
    *
+   * Line reads fetch whatever is available into an internal read-ahead
+   * buffer and search it for the EOL, instead of reading one byte at a
+   * time. Bytes after the EOL stay in that buffer; every read, available
+   * and waitReadable call sees them first. Code polling getFd() directly
+   * must check available() before waiting if it mixes in line reads.
+   *
    * \param buffer A std::string reference used to store the data.
    * \param size A maximum length of a line, defaults to 65536 (2^16)
    * \param eol A string to match against for the EOL.
@@ -371,6 +523,49 @@ public:
   size_t
   write (const uint8_t *data, size_t size);
 
+  /*! Non-throwing write, with the same error codes as the non-throwing
+   * read. A timeout returns the bytes written so far with ec cleared. */
+  size_t
+  write (const uint8_t *data, size_t size, std::error_code &ec) noexcept;
+
+  /*! Queue data for transmission without waiting for the line.
+   *
+   * Whatever the kernel transmit buffer takes is written immediately; the
+   * rest (up to 64 KiB outstanding) is handed to a background thread that
+   * feeds the port as it drains. Bytes go out in call order, also relative
+   * to the blocking write overloads, which first wait for the queue.
+   *
+   * \return size if the data was accepted, or 0. The data is never split:
+   * if it does not fit in the queue, nothing is written and ec is set to
+   * std::errc::no_buffer_space. A failure of an earlier queued write is
+   * reported by the next call (returning 0) or by takeWriteError.
+   */
+  size_t
+  writeAsync (const uint8_t *data, size_t size, std::error_code &ec) noexcept;
+
+  /*! Report and clear the failure of an earlier queued write, if any, so a
+   * reader thread can notice it without waiting for the next writeAsync.
+   *
+   * \return true if a queued write had failed; ec holds the error.
+   */
+  bool
+  takeWriteError (std::error_code &ec) noexcept;
+
+  /*! Return the number of bytes still waiting to be transmitted: the
+   * writeAsync queue plus the driver output queue (TIOCOUTQ). */
+  size_t
+  writePending () noexcept;
+
+  /*! Block until everything written so far has left the UART, or timeout_ms
+   * passes. Unlike flush(), sleeps in steps sized from the baud rate and
+   * the remaining byte count rather than inside tcdrain.
+   *
+   * \return true if the output is drained. false on timeout (ec cleared)
+   * or on an error of a queued write (ec set).
+   */
+  bool
+  waitWriteComplete (uint32_t timeout_ms, std::error_code &ec) noexcept;
+
   /*! Write a string to the serial port.
    *
    * \param data A const reference containing the data to be written
@@ -586,6 +781,48 @@ public:
   flowcontrol_t
   getFlowcontrol () const;
 
+  /*! Enables or disables the low latency profile.
+   *
+   * When enabled the driver's ASYNC_LOW_LATENCY flag is set through
+   * TIOCSSERIAL, the UART RX FIFO trigger level is lowered to one byte
+   * where the driver exposes rx_trig_bytes in sysfs, and read() no longer
+   * sleeps for the transmission time of the missing bytes before reading.
+   * Settings the driver does not support are skipped silently.
+   *
+   * \param enabled true to enable the low latency profile.
+   *
+   * \throw serial::IOException
+   */
+  void
+  setLowLatency (bool enabled);
+
+  /*! Returns true if the low latency profile is enabled. */
+  bool
+  getLowLatency () const;
+
+  /*! Moves the port's I/O onto io_uring (Linux only).
+   *
+   * A read into a registered buffer is kept posted on a ring shared by every
+   * port in the process, so available, read and waitReadable are served from
+   * its completions without a select and read per call. Writes, including
+   * writeAsync, are queued and submitted in batches, each linked to a
+   * timeout computed from the write timeout.
+   *
+   * The setting survives close and open. Switch while the port is idle:
+   * bytes received but not yet read are dropped when disabling.
+   *
+   * \param enabled true to use io_uring, false for select and read/write.
+   *
+   * \return true if io_uring is in use after the call; false if disabled,
+   * the port is closed, or the kernel does not support it.
+   */
+  bool
+  setIoUring (bool enabled);
+
+  /*! Returns true if the port's I/O currently goes through io_uring. */
+  bool
+  getIoUring () const;
+
   /*! Flush the input and output buffers */
   void
   flush ();
@@ -623,6 +860,8 @@ public:
    * resolution of less than +-1ms and as good as +-0.2ms.  Otherwise a
    * polling method is used which can give +-2ms.
    *
+   * See startModemMonitor for a non-blocking, cancellable alternative.
+   *
    * \return Returns true if one of the lines changed, false if something else
    * occurred.
    *
@@ -631,6 +870,29 @@ public:
   bool
   waitForChange ();
 
+  /*!
+   * Starts a thread that watches CTS, DSR, RI and CD and calls callback on
+   * every change, starting with one event for the initial state.
+   *
+   * The thread sleeps in TIOCMIWAIT where the driver supports it and polls
+   * every 10 ms otherwise. Edges are taken from the driver's interrupt
+   * counters (TIOCGICOUNT) when available, so a short pulse is reported
+   * even if the line is back at its old level when it is read. A hangup
+   * ends the monitor with a final event that drops all lines.
+   *
+   * The callback runs on the monitor thread and must not call
+   * stopModemMonitor or close.
+   *
+   * \return false if the port is not open, has no modem lines (e.g. a pty)
+   * or the monitor is already running.
+   */
+  bool
+  startModemMonitor (const ModemCallback &callback);
+
+  /*! Stops the modem monitor and waits for its thread. Called by close(). */
+  void
+  stopModemMonitor ();
+
   /*! Returns the current status of the CTS line. */
   bool
   getCTS ();
@@ -647,6 +909,16 @@ public:
   bool
   getCD ();
 
+  /*! Returns the underlying file descriptor, or -1 if the port is not open.
+   *
+   * The descriptor is non-blocking and may be added to an external poll()
+   * or epoll loop to wait for readability instead of calling waitReadable.
+   * While io_uring is in use (see setIoUring) the ring consumes the input,
+   * so the descriptor's readability means nothing; use waitReadable.
+   */
+  int
+  getFd () const;
+
 private:
   // Disable copy constructors
   Serial(const Serial&);
@@ -660,6 +932,23 @@ private:
   class ScopedReadLock;
   class ScopedWriteLock;
 
+  // Read-ahead buffer used by readline/readlines, guarded by the read lock.
+  // rbuf_avail_ mirrors the buffered byte count for lock-free available().
+  std::vector<uint8_t> rbuf_;
+  size_t rbuf_head_;
+  std::atomic<size_t> rbuf_avail_;
+
+  size_t
+  fill_ ();
+  void
+  consume_ (size_t count);
+  void
+  clearReadAhead_ ();
+  size_t
+  takeReadAhead_ (uint8_t *buffer, size_t size);
+  size_t
+  readline_ (std::string &buffer, size_t size, const std::string &eol);
+
   // Read common function
   size_t
   read_ (uint8_t *buffer, size_t size);
@@ -0,0 +1,112 @@
+#ifndef __SMARTWIN_BOUNDED_QUEUE_H__
+#define __SMARTWIN_BOUNDED_QUEUE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+
+/**
+ * @brief 队列满时的处理策略
+ */
+#define SW_OVERFLOW_DROP_OLDEST     (0x00)      /**< 丢弃最旧的元素 */
+#define SW_OVERFLOW_DROP_NEWEST     (0x01)      /**< 丢弃新元素 */
+#define SW_OVERFLOW_COALESCE        (0x02)      /**< 新元素覆盖最新的元素, 合并为最新状态 */
+
+namespace smartwin {
+
+/**
+ * @brief 队列统计
+ */
+struct smartwin_queue_stats {
+    uint32_t capacity;              /**< 容量 */
+    uint32_t depth;                 /**< 当前元素数 */
+    uint32_t max_depth;             /**< 元素数历史最大值 */
+    uint8_t policy;                 /**< 队列满时的处理策略 @see SW_OVERFLOW_DROP_OLDEST */
+    uint64_t pushed;                /**< 入队次数 */
+    uint64_t dropped;               /**< 因队列满被丢弃或合并的元素数 */
+};
+
+/**
+ * @brief 有界队列
+ * 容量固定, 满时按策略丢弃或合并, 内存占用有上限.
+ * 本身不加锁, 由调用者使用对应的互斥锁保护.
+ */
+template <typename T>
+class smartwin_bounded_queue {
+
+private:
+    std::deque<T> items_;
+    smartwin_queue_stats stats_;
+
+public:
+    typedef typename std::deque<T>::iterator iterator;
+
+    smartwin_bounded_queue(uint32_t capacity, uint8_t policy) {
+        stats_ = {};
+        stats_.capacity = capacity > 0 ? capacity : 1;
+        stats_.policy = policy;
+    }
+
+    /**
+     * @brief 入队
+     * @return 元素入队返回true, 被丢弃返回false
+     */
+    bool push(const T& item) {
+        stats_.pushed++;
+
+        if(items_.size() >= stats_.capacity) {
+            stats_.dropped++;
+            switch(stats_.policy) {
+            case SW_OVERFLOW_DROP_NEWEST:
+                return false;
+            case SW_OVERFLOW_COALESCE:
+                items_.back() = item;
+                return true;
+            default:
+                while(items_.size() >= stats_.capacity) {
+                    items_.pop_front();
+                }
+                break;
+            }
+        }
+
+        items_.push_back(item);
+        if(items_.size() > stats_.max_depth) {
+            stats_.max_depth = items_.size();
+        }
+        return true;
+    }
+
+    /**
+     * @brief 修改容量和策略, 超出新容量的最旧元素被丢弃
+     */
+    void set_config(uint32_t capacity, uint8_t policy) {
+        stats_.capacity = capacity > 0 ? capacity : 1;
+        stats_.policy = policy;
+        while(items_.size() > stats_.capacity) {
+            items_.pop_front();
+            stats_.dropped++;
+        }
+    }
+
+    void get_stats(smartwin_queue_stats& stats) const {
+        stats = stats_;
+        stats.depth = items_.size();
+    }
+
+    bool empty() const { return items_.empty(); }
+    size_t size() const { return items_.size(); }
+    void clear() { items_.clear(); }
+
+    T& front() { return items_.front(); }
+    T& back() { return items_.back(); }
+    void pop_front() { items_.pop_front(); }
+
+    iterator begin() { return items_.begin(); }
+    iterator end() { return items_.end(); }
+    iterator erase(iterator it) { return items_.erase(it); }
+};
+
+}
+
+#endif
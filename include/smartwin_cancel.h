@@ -0,0 +1,33 @@
+#ifndef __SMARTWIN_CANCEL_H__
+#define __SMARTWIN_CANCEL_H__
+
+#include <atomic>
+
+namespace smartwin {
+
+/**
+ * @brief 取消令牌
+ * 传给耗时操作(扫码, 联机PIN输入, 寻卡), 在任意线程调用cancel()后,
+ * 等待中的调用立即返回SDK_ESC, 库发送对应的关闭/停止命令并丢弃迟到的应答.
+ */
+class smartwin_cancel_token {
+
+private:
+    std::atomic<bool> cancelled_;
+
+public:
+    smartwin_cancel_token() : cancelled_(false) {}
+
+    smartwin_cancel_token(const smartwin_cancel_token&) = delete;
+    smartwin_cancel_token& operator=(const smartwin_cancel_token&) = delete;
+
+    void cancel() { cancelled_.store(true); }
+
+    bool is_cancelled() const { return cancelled_.load(); }
+
+    void reset() { cancelled_.store(false); }
+};
+
+}
+
+#endif
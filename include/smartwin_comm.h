@@ -6,12 +6,26 @@
 #include <string>
 #include <stdint.h> 
 #include <functional>
+#include <atomic>
 #include <unistd.h>
 
 #define SERIAL_DEBUG_INFO 1
 
 namespace smartwin {
 
+/**
+ * @brief 串口超时模型, 由波特率和帧格式推算
+ * 读写N字节的超时 = turnaround_ms + N * per_byte_us
+ */
+struct smartwin_serial_timing {
+    uint32_t baudrate;              /**< 波特率 */
+    uint32_t byte_time_ns;          /**< 单字节线路时间(起始位+数据位+停止位), 单位: ns */
+    uint32_t margin_pct;            /**< 线路时间余量, 200表示按2倍字节时间计算 */
+    uint32_t per_byte_us;           /**< 每字节超时, 单位: us */
+    uint32_t turnaround_ms;         /**< 固件处理及调度余量, 单位: ms */
+    uint32_t max_frame_ms;          /**< 最大帧(4K数据)的接收超时, 单位: ms */
+};
+
 class smartwin_comm {
 
 private:
@@ -22,14 +36,87 @@ private:
 
     std::function<void(std::vector<uint8_t>)> recv_callback_;
 
+    // 接收线程每轮循环调用一次, 用于后台定时任务
+    std::function<void()> tick_callback_;
+    std::atomic<bool> tick_set_{false};
+
     bool thread_flag_ = false;
 
+    // 无线程模式: 不创建接收线程, 由应用调用process()驱动
+    bool threadless_ = false;
+
+    // 低延迟模式: 接收线程空闲时poll()等待串口可读, 代替固定休眠
+    std::atomic<bool> low_latency_{false};
+
+    // io_uring后端: 串口输入由ring接收, fd不再反映可读状态, 空闲等待改用waitReadable()
+    bool io_uring_ = false;
+
+    // 超时模型, 半帧超过frame_timeout_ms()未收完则丢弃重新同步
+    smartwin_serial_timing timing_ = {};
+
+    int frame_timeout_ms(size_t bytes) const;
+    int update_timing(uint32_t turnaround_ms, uint32_t margin_pct);
+
+    // 校验通过/失败的帧数, 用于波特率回退
+    std::atomic<uint32_t> frames_ok_{0};
+    std::atomic<uint32_t> frames_bad_{0};
+
+    // 串口断开(USB热拔插, 安全芯片复位后重新枚举)时关闭, 按指数退避重新打开,
+    // 退避从reopen_min_ms_开始每次翻倍, 不超过reopen_max_ms_
+    std::atomic<bool> port_up_{true};
+    uint32_t reopen_min_ms_ = 10;
+    uint32_t reopen_max_ms_ = 200;
+    uint32_t reopen_backoff_ms_ = 0;
+    uint64_t reopen_at_ms_ = 0;
+    uint64_t lost_at_ms_ = 0;
+    // 接收线程在锁外等待串口可读, 其他线程发现断开时不关闭串口, 由接收线程关闭; 由cmd_recv_mutex_保护
+    bool close_pending_ = false;
+    std::atomic<uint32_t> reconnects_{0};
+    std::function<void(bool, uint32_t)> link_callback_;
+    serial::ModemCallback modem_callback_;
+
+    void port_lost(const std::error_code& err);
+    void port_close();
+    bool port_reopen();
+    void check_write_error();
+    void link_notify(bool up, uint32_t down_ms);
+
+    // 增量帧解析状态, 供process()使用
+    enum {
+        FRAME_STX = 0,
+        FRAME_HEAD,
+        FRAME_DATA,
+        FRAME_ETX,
+        FRAME_LRC,
+    };
+    int frame_state_ = FRAME_STX;
+    size_t frame_need_ = 0;
+    uint64_t frame_deadline_ = 0;
+    std::vector<uint8_t> frame_buf_;
+
+    // 当前帧首字节读取时间和帧接收完成时间(us), 在接收回调中有效
+    uint64_t frame_start_us_ = 0;
+    uint64_t frame_end_us_ = 0;
+
+    int parse_bytes(const uint8_t* data, size_t len);
+    void frame_reset();
+
 public:
 
-    smartwin_comm(std::string port_name, int baudrate, int timeout,
-                    std::function<void(std::vector<uint8_t>)> callback);
+    /**
+     * @param[in] turnaround_ms 固件处理及调度余量, 串口读写超时在此基础上按波特率累加每字节线路时间
+     * @param[in] io_uring 使用io_uring收发(仅Linux), 内核不支持或无线程模式下忽略
+     */
+    smartwin_comm(std::string port_name, int baudrate, int turnaround_ms,
+                    std::function<void(std::vector<uint8_t>)> callback, bool threadless = false,
+                    bool io_uring = false);
 
     ~smartwin_comm();
+
+    /**
+     * @brief 停止接收线程, 之后不再调用接收回调和周期回调; 可重复调用, 析构时也会调用
+     */
+    void stop();
     
     std::string printBuf(std::string t_str, std::vector<uint8_t> buf);
     std::string printBuf(std::string t_str, uint8_t* buf, int ln);
@@ -40,6 +127,145 @@ public:
 
     static void* cmd_recv_thread_func(void* arg);
 
+    /**
+     * @brief 获取串口文件描述符, 无线程模式下加入应用的poll()循环
+     * @return 文件描述符, 串口未打开返回-1
+     */
+    int get_fd();
+
+    /**
+     * @brief 距下一个定时器到期的时间, 作为poll()的超时参数
+     * @return 剩余毫秒数, 无定时器返回-1
+     */
+    int get_timeout();
+
+    /**
+     * @brief 非阻塞处理: 读取当前可读字节, 解析并分发完整帧
+     * @return 本次分发的帧数, 失败返回SDK_ERROR
+     */
+    int process();
+
+    /**
+     * @brief 等待串口可读(最多timeout_ms)后调用process()
+     * @return 同process()
+     */
+    int process_wait(int timeout_ms);
+
+    bool is_threadless() const { return threadless_; }
+
+    /**
+     * @brief 调整超时模型, 按当前波特率重新计算串口读写超时
+     * @param[in] turnaround_ms 固件处理及调度余量 ms
+     * @param[in] margin_pct 线路时间余量, 100表示按标称字节时间, 须不小于100
+     * @return 成功返回SDK_OK, 参数错误返回SDK_PARAMERR
+     */
+    int set_timing(uint32_t turnaround_ms, uint32_t margin_pct);
+
+    /**
+     * @brief 获取当前超时模型
+     * @param[out] timing 超时模型
+     */
+    void get_timing(smartwin_serial_timing& timing) const { timing = timing_; }
+
+    /**
+     * @brief 切换主机侧波特率, 发送队列发完后生效, 丢弃未读数据并重新计算超时模型
+     * 非标准波特率通过termios2(BOTHER)设置
+     * @param[in] baudrate 波特率
+     * @return 成功返回SDK_OK，失败返回SDK_ERROR
+     */
+    int set_baudrate(uint32_t baudrate);
+
+    uint32_t get_baudrate() const { return timing_.baudrate; }
+
+    /**
+     * @brief 设置RTS/CTS硬件流控
+     * @param[in] enable 是否启用
+     * @return 成功返回SDK_OK，失败返回SDK_ERROR
+     */
+    int set_flow_control(bool enable);
+
+    /**
+     * @brief 启动串口状态线(CTS/DSR/RI/CD)监视线程
+     * @param[in] callback 状态线变化回调, 在监视线程中执行
+     * @return 成功返回SDK_OK, 串口没有状态线或已启动返回SDK_ERROR
+     */
+    int start_modem_monitor(serial::ModemCallback callback);
+
+    /**
+     * @brief 丢弃未读数据和未收完的半帧, 用于安全芯片复位后重新同步
+     */
+    void flush_input();
+
+    /**
+     * @brief 设置串口断开后的重连退避
+     * 读写返回设备不存在/IO错误时关闭串口, 等待min_ms后重新打开, 失败则等待时间翻倍, 最长max_ms;
+     * 重新打开后恢复波特率, 流控, 低延迟等配置并重启状态线监视
+     * @param[in] min_ms 首次重连等待 ms
+     * @param[in] max_ms 最长重连间隔 ms, 0表示断开后不再重连
+     */
+    void set_reconnect(uint32_t min_ms, uint32_t max_ms);
+
+    /**
+     * @brief 设置串口断开/重连回调, 在接收线程(无线程模式下为process()的调用者)中执行
+     * @param[in] callback up: 是否已重新打开, down_ms: 重新打开时为断开时长 ms
+     */
+    void set_link_callback(std::function<void(bool up, uint32_t down_ms)> callback);
+
+    /**
+     * @brief 串口是否处于打开状态, 断开后重连期间为false
+     */
+    bool port_is_up() const { return port_up_.load(); }
+
+    /**
+     * @brief 获取断开后成功重连的次数
+     */
+    uint32_t get_reconnect_count() const { return reconnects_.load(); }
+
+    /**
+     * @brief 获取累计收到的帧数
+     * @param[out] ok 校验通过的帧数
+     * @param[out] bad 帧尾或校验错误的帧数
+     */
+    void get_frame_stats(uint32_t& ok, uint32_t& bad) const {
+        ok = frames_ok_.load(std::memory_order_relaxed);
+        bad = frames_bad_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 设置低延迟模式
+     * 串口启用低延迟配置(驱动ASYNC_LOW_LATENCY, RX FIFO触发深度1字节, 读取时不按字节时间等待),
+     * 接收线程空闲时阻塞等待串口可读, 数据到达立即处理, 不再固定休眠20ms
+     * @param[in] enable 是否启用
+     * @return 成功返回SDK_OK，失败返回SDK_ERROR
+     */
+    int set_low_latency(bool enable);
+
+    /**
+     * @brief 串口是否使用io_uring收发
+     */
+    bool get_io_uring() const { return io_uring_; }
+
+    /**
+     * @brief 当前帧首字节(0x02)读取时间, 只能在接收回调中调用
+     * @return 单调时钟 us
+     */
+    uint64_t frame_start_us() const { return frame_start_us_; }
+
+    /**
+     * @brief 当前帧接收完成(校验通过)时间, 只能在接收回调中调用
+     * @return 单调时钟 us
+     */
+    uint64_t frame_end_us() const { return frame_end_us_; }
+
+    /**
+     * @brief 设置接收线程的周期回调(约20ms一次), 只能设置一次
+     * @param[in] callback 回调, 在接收线程中执行, 可调用sendcmd
+     */
+    void set_tick_callback(std::function<void()> callback) {
+        tick_callback_ = callback;
+        tick_set_.store(true, std::memory_order_release);
+    }
+
     uint8_t t_buffer[1024];
 
 };
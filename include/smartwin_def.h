@@ -9,6 +9,8 @@
 #define SDK_PARAMERR                        (-2)    /**< 参数错误 */
 #define SDK_ESC                             (-120)  /**< 取消退出 */
 #define SDK_TIMEOUT                         (-121)  /**< 超时 */
+#define SDK_LINK_DOWN                       (-122)  /**< 安全芯片掉电或复位, 等待中的应答已失效 */
+#define SDK_LINK_LOST                       (-123)  /**< 串口断开(热拔插或复位后重新枚举), 正在重连, 等待中的应答已失效 */
 
 /**
  * @brief 磁条卡错误码定义
@@ -5,7 +5,20 @@
 #include <stdio.h>
 #include "smartwin_def.h"
 #include "smartwin_comm.h"
+#include "smartwin_executor.h"
+#include "smartwin_event.h"
+#include "smartwin_cancel.h"
+#include "smartwin_timeout_policy.h"
+#include "smartwin_spsc_ring.h"
+#include "smartwin_presence.h"
+#include "smartwin_dispatch.h"
+#include "smartwin_bounded_queue.h"
+#include "smartwin_touch_rate.h"
+#include "smartwin_link_rate.h"
+#include "smartwin_latency.h"
+#include <atomic>
 #include <vector>
+#include <deque>
 #include <mutex>
 using namespace std;
 
@@ -23,19 +36,179 @@ private:
 
     int recv_timeout = 2000;  //ms
 
-    pthread_mutex_t recv_list_mutex_;
-    std::vector<std::vector<uint8_t>> recv_list;
+    // 按命令字学习的应答超时
+    smartwin_timeout_policy* timeout_policy_ = nullptr;
 
-    std::vector<std::vector<uint8_t>> keyinput_list;
-    std::vector<std::vector<uint8_t>> search_card_list;
-    std::vector<std::vector<uint8_t>> tpinput_list;
-    std::vector<std::vector<uint8_t>> icstatus_list;
+    // 所有接收队列均有容量上限, 满时按策略丢弃或合并
+    pthread_mutex_t recv_list_mutex_;
+    struct response_frame {
+        std::vector<uint8_t> buf;
+        uint64_t rx_us;         // 整帧接收完成时间
+    };
+    smartwin_bounded_queue<response_frame> recv_list{32, SW_OVERFLOW_DROP_OLDEST};
+
+    // 已发出等待应答的请求, 按发送顺序排列, 由recv_list_mutex_保护.
+    // 链路按顺序应答: 一个应答属于同命令字, 在它到达之前发出的最早的请求;
+    // 不属于任何请求的应答是之前超时或取消的命令迟到的应答
+    enum {
+        REQUEST_NONE = 0,       // 不等待应答
+        REQUEST_APP,
+        REQUEST_PRESENCE,       // 后台在位检测, 应答交给presence_
+    };
+    struct pending_request {
+        uint64_t seq;
+        uint8_t cmd;
+        uint8_t owner;
+        uint64_t send_us;
+        uint64_t deadline_us;   // 等待者异常未取走时的兜底清理时间
+    };
+    std::deque<pending_request> pending_;
+    uint64_t request_seq_ = 0;
+
+    // 调用线程最近发出的请求, recv_from_list按它匹配应答; 可重发命令保留请求帧供replay_request重发
+    struct request_record {
+        uint64_t seq;           // 0表示没有等待应答的请求
+        uint8_t cmd;
+        uint64_t send_us;
+        uint32_t link_epoch;    // 发送前的epoch, 发送和等待之间的断开与重连也能发现
+        uint32_t port_epoch;
+        int send_ret;           // sendcmd的返回值, 失败时不等待应答
+        std::vector<uint8_t> frame;
+    };
+    static thread_local request_record current_request_;
+
+    int send_request(const std::vector<uint8_t>& frame, uint8_t owner);
+    void hold_request(uint64_t seq, int timeout_ms);
+    void end_request(uint64_t seq, uint8_t cmd, int discard_ms);
+    const pending_request* response_owner(const response_frame& frame);
+    bool presence_response(const std::vector<uint8_t>& buf);
+    bool app_request_pending();
+    int recv_response(const request_record& req, std::vector<uint8_t>& buf, int timeout_ms, smartwin_cancel_token* token);
+
+    smartwin_bounded_queue<std::vector<uint8_t>> search_card_list{4, SW_OVERFLOW_COALESCE};
+
+    // 按键事件: 接收线程入队, 调用keyboard_get_input的线程出队
+    smartwin_spsc_ring<smartwin_key_event, 64> key_ring_;
+    std::atomic<int> key_waiters_;
+    pthread_mutex_t key_wait_mutex_;
+    pthread_cond_t key_wait_cond_;
+    std::atomic<uint64_t> key_pushed_;
+    std::atomic<uint64_t> key_dropped_;
+    std::atomic<uint32_t> key_max_depth_;
+
+    // 触摸点: 接收线程入队, 调用tp_drain_touch_events的线程出队
+    smartwin_spsc_ring<smartwin_touch_point, 256> touch_ring_;
+    std::atomic<uint32_t> touch_gap_ms_;   // 超过该间隔无上报视为抬起
+    std::atomic<uint64_t> touch_last_us_{0};   // 生产者: 上一个点的接收时间, tp_open清零
+    uint8_t touch_push_action_ = SW_TOUCH_UP;  // 生产者: 上一个点的动作, 同步到事件队列
+    smartwin_touch_point touch_last_ = {};  // 消费者: 上一个交付的点
+    std::atomic<uint64_t> touch_pushed_;
+    std::atomic<uint64_t> touch_dropped_;
+    std::atomic<uint32_t> touch_max_depth_;
+
+    // 按键/触摸从首字节读取到应用取出的各阶段延迟
+    smartwin_latency_recorder input_latency_[SW_LATENCY_SOURCE_COUNT][SW_LATENCY_STAGE_COUNT];
+    void record_input_latency(uint8_t source, uint64_t rx_start_us, uint64_t rx_end_us);
+
+    // 按应用读取频率调整触摸上报间隔
+    smartwin_touch_rate* touch_rate_ = nullptr;
+    std::atomic<uint32_t> tp_area_[4];     // 应用设置的有效区域 start_x, start_y, end_x, end_y
+
+    // 探测得到的波特率, 校验错误率升高时回退; 只在设备支持自动波特率时启用
+    static bool autobaud_;
+    smartwin_link_rate* link_rate_ = nullptr;
+    std::atomic<bool> link_rate_switching_{false};
+    bool link_probe_ok();
+
+    // 状态线监视: 监视的线全部有效时认为安全芯片在线, 每次掉线或复位脉冲epoch加1,
+    // 等待中的请求发现epoch变化后立即返回SDK_LINK_DOWN
+    std::atomic<bool> link_up_{true};
+    std::atomic<uint32_t> link_epoch_{0};
+
+    // 串口断开/重连: 断开时port_epoch_加1, 等待中的请求立即返回SDK_LINK_LOST
+    std::atomic<bool> port_up_{true};
+    std::atomic<uint32_t> port_epoch_{0};
+    void on_port_event(bool up, uint32_t down_ms);
+
+    // 幂等命令在断开恢复后重发一次, 由set_link_replay启用
+    static bool link_replay_;
+    static uint32_t reconnect_min_ms_;
+    static uint32_t reconnect_max_ms_;
+    std::atomic<bool> replay_cmd_[256];
+    int replay_request(const std::vector<uint8_t>& request, std::vector<uint8_t>& buf, int timeout_ms);
+    void on_modem_event(const serial::ModemEvent& ev);
+
+    smartwin_bounded_queue<std::vector<uint8_t>> icstatus_list{4, SW_OVERFLOW_COALESCE};
 
-    pthread_mutex_t keyinput_list_mutex_;
     pthread_mutex_t search_card_list_mutex_;
-    pthread_mutex_t tpinput_list_mutex_;
     pthread_mutex_t icstatus_list_mutex_;
 
+    static bool threadless_mode_;
+    static bool low_latency_mode_;
+    static bool io_uring_mode_;
+    static std::string port_name_;
+    static int baudrate_;
+    static bool flow_control_;
+    static uint8_t link_lines_;
+
+    // 用户回调在执行器中运行, 不阻塞接收线程
+    smartwin_executor* executor_ = nullptr;
+    pthread_mutex_t event_callback_mutex_;
+    std::function<void(std::vector<uint8_t>)> event_callbacks_[256];
+
+    // 统一事件队列, 调用event_get_fd()后启用
+    int event_fd_ = -1;
+    smartwin_bounded_queue<smartwin_event> event_list{256, SW_OVERFLOW_DROP_OLDEST};
+    pthread_mutex_t event_list_mutex_;
+
+    // 取消后迟到应答的丢弃表, 由recv_list_mutex_保护
+    struct discard_entry {
+        bool active;
+        uint8_t until_cmd;      // 收到该命令字的应答后停止丢弃
+        uint64_t deadline_ms;   // 兜底超时
+    };
+    discard_entry discard_table_[256] = {};
+    int discard_active_ = 0;
+
+    smartwin_cancel_token* search_card_token_ = nullptr;
+    uint32_t search_card_timeout_ = 0;
+    bool search_card_stopped_ = false;  // 令牌已取消, 停止命令已由tick()发出
+
+    // 寻卡结果到达时唤醒search_card_wait或投递一次性回调, 由search_card_list_mutex_保护
+    pthread_cond_t search_card_cond_;
+    uint64_t search_card_detect_us_ = 0;
+    uint64_t search_card_rx_start_us_ = 0;
+    std::function<void(int, uint8_t, uint8_t)> search_card_callback_;
+    smartwin_latency_recorder search_card_latency_;
+
+    // 后台卡片在位检测, 应用有请求未应答时暂停发送
+    smartwin_presence* presence_ = nullptr;
+
+    void recv_wait(int ms);
+    void tick();
+    void push_event(const smartwin_event& ev);
+
+    // 按命令字分发接收帧
+    smartwin_dispatcher* dispatcher_ = nullptr;
+    void push_list(smartwin_bounded_queue<std::vector<uint8_t>>& list, pthread_mutex_t& mutex,
+        const std::vector<uint8_t>& buf, uint8_t policy);
+    void push_key_event(const std::vector<uint8_t>& buf);
+    void push_touch_point(const std::vector<uint8_t>& buf);
+    bool touch_release(smartwin_touch_point& pt);
+    void push_search_card(const std::vector<uint8_t>& buf, uint8_t policy);
+    int parse_search_card(const std::vector<uint8_t>& buf, uint8_t &type, uint8_t &key);
+    bool search_card_check_cancel();
+    void search_card_poll_cancel();
+    int search_card_send(uint8_t search_mode, uint32_t timeout_ms, smartwin_cancel_token* token,
+        std::function<void(int, uint8_t, uint8_t)> callback);
+    void search_card_record_wake(uint64_t detect_us);
+    void discard_late_response(uint8_t cmd, uint8_t until_cmd, int timeout_ms);
+    void mark_discard(uint8_t cmd, uint8_t until_cmd, int timeout_ms);
+    bool discard_frame(const std::vector<uint8_t>& buf);
+    void cancel_abort(uint8_t cmd, uint8_t close_cmd, int timeout_ms);
+    void post_event_callback(const std::vector<uint8_t>& buf);
+    void push_event(const std::vector<uint8_t>& buf, smartwin_frame_decoder decoder);
+
 public:
     static smartwin_devices* getInstance() {
         static smartwin_devices instance;
@@ -43,8 +216,225 @@ public:
         return &instance;
     }
 
+    /**
+     * @brief 设置无线程模式, 须在第一次调用getInstance()之前设置
+     * 无线程模式下库不创建任何线程, 应用将get_fd()加入自己的poll()循环,
+     * 以get_timeout()作为超时, 并在返回后调用process()
+     * @param[in] enable true: 无线程模式, false: 默认的接收线程模式
+     */
+    static void set_threadless_mode(bool enable) { threadless_mode_ = enable; }
+
+    /**
+     * @brief 设置串口低延迟模式, 须在第一次调用getInstance()之前设置
+     * 启用后驱动设置ASYNC_LOW_LATENCY, 降低RX FIFO触发深度(驱动支持时), 接收线程
+     * 空闲时等待串口可读而不是固定休眠20ms, 缩短beep, led_on等短帧命令的往返时间, CPU唤醒次数略增
+     * @param[in] enable true: 低延迟模式, false: 默认模式
+     */
+    static void set_low_latency_mode(bool enable) { low_latency_mode_ = enable; }
+
+    /**
+     * @brief 设置串口使用io_uring收发(仅Linux), 须在第一次调用getInstance()之前设置
+     * 接收常驻一个注册缓冲区读请求, 发送批量提交并链接写超时, 减少每帧的系统调用和上下文切换;
+     * 内核不支持(早于5.7或被禁用)时自动使用原有方式. 无线程模式下忽略
+     * @param[in] enable true: io_uring, false: pselect+read/write(默认)
+     */
+    static void set_io_uring_mode(bool enable) { io_uring_mode_ = enable; }
+
+    /**
+     * @brief 设置安全芯片串口, 须在第一次调用getInstance()之前设置, 用于调试或模拟器(pty)
+     * @param[in] port_name 串口设备, 默认/dev/ttyS1
+     * @param[in] baudrate 波特率, 默认460800
+     */
+    static void set_port(const std::string& port_name, int baudrate) {
+        port_name_ = port_name;
+        baudrate_ = baudrate;
+    }
+
+    /**
+     * @brief 设置RTS/CTS硬件流控, 须在第一次调用getInstance()之前设置
+     * 921600以上的波特率建议启用, 避免UART FIFO溢出; 需要硬件连接RTS/CTS
+     * @param[in] enable true: 启用, false: 不使用流控(默认)
+     */
+    static void set_flow_control(bool enable) { flow_control_ = enable; }
+
+    /**
+     * @brief 声明安全芯片支持自动波特率, 须在调用link_probe_baudrate之前设置
+     * 固件没有切换波特率的命令, 主机侧换档后设备须能自动跟随; 未设置时link_probe_baudrate
+     * 只验证当前波特率, 不升档也不回退, 避免固定波特率的设备与主机失步
+     * @param[in] enable true: 设备支持自动波特率, false: 设备波特率固定(默认)
+     */
+    static void set_autobaud(bool enable) { autobaud_ = enable; }
+
+    /**
+     * @brief 设置用于检测安全芯片掉电/复位的串口状态线, 须在第一次调用getInstance()之前设置
+     * 启动监视线程(TIOCMIWAIT), 状态线变化时产生SW_EVENT_MODEM事件. 监视的线任一无效时
+     * 等待应答的请求立即返回SDK_LINK_DOWN, 不再等到超时; 恢复有效后丢弃串口中的残留数据
+     * @param[in] lines 状态线 @see SW_MODEM_CD, SW_MODEM_DSR, 0表示不监视(默认)
+     */
+    static void set_link_monitor(uint8_t lines) { link_lines_ = lines; }
+
+    /**
+     * @brief 设置串口断开后的重连退避, 须在第一次调用getInstance()之前设置
+     * 读写发现设备不存在(USB串口拔出, 安全芯片复位后重新枚举)时关闭串口, 等待中的请求立即返回
+     * SDK_LINK_LOST; 之后等待min_ms重新打开, 每次失败间隔翻倍, 最长max_ms. 断开和重连产生SW_EVENT_LINK事件
+     * @param[in] min_ms 首次重连等待, 默认10ms
+     * @param[in] max_ms 最长重连间隔, 默认200ms, 0表示不重连
+     */
+    static void set_reconnect(uint32_t min_ms, uint32_t max_ms) {
+        reconnect_min_ms_ = min_ms;
+        reconnect_max_ms_ = max_ms;
+    }
+
+    /**
+     * @brief 设置断开恢复后是否重发幂等命令, 须在第一次调用getInstance()之前设置
+     * 启用后, 幂等命令(查询类, 设置固定状态类, 见set_replay_command)的应答因SDK_LINK_LOST或SDK_LINK_DOWN失效时,
+     * 在该命令的超时上限(smartwin_timeout_config::max_ms)内等待链路恢复并重发一次; 其他命令仍直接返回错误
+     * @param[in] enable true: 重发, false: 不重发(默认)
+     */
+    static void set_link_replay(bool enable) { link_replay_ = enable; }
+
+    /**
+     * @brief 标记命令是否可在断开恢复后重发
+     * @param[in] cmd 命令字 @see CMD_GET_DEVICE_MODEL
+     * @param[in] idempotent 重复执行与执行一次效果相同
+     * @return 成功返回SDK_OK
+     */
+    int set_replay_command(uint8_t cmd, bool idempotent);
+
+    /**
+     * @brief 安全芯片是否在线: 串口已打开, 且设置了set_link_monitor时监视的状态线全部有效
+     */
+    bool link_is_up() const { return port_up_.load() && link_up_.load(); }
+
+    /**
+     * @brief 获取串口文件描述符(无线程模式)
+     * 串口断开重连后描述符会变化, 每次poll()前重新获取
+     * @return 文件描述符, 失败或断开期间返回-1
+     */
+    int get_fd();
+
+    /**
+     * @brief 距库内下一个定时器到期的毫秒数(无线程模式)
+     * @return 剩余毫秒数, 无定时器返回-1
+     */
+    int get_timeout();
+
+    /**
+     * @brief 非阻塞处理串口数据, 解析并分发完整帧(无线程模式)
+     * @return 本次处理的帧数, 失败返回错误码
+     */
+    int process();
+
+    /**
+     * @brief 设置主动上报事件回调
+     * 回调在执行器线程中运行(无线程模式下在process()中运行), 同一命令字的回调按上报顺序执行
+     * @param[in] cmd 上报命令字 @see CMD_READ_KEYBOARD_INPUT, CMD_GET_TOUCH_COORDINATE, CMD_SEARCH_CARD_START, CMD_CHECK_IC_STATUS
+     * @param[in] callback 回调, 参数为完整的上报帧; 传入nullptr取消回调
+     * @return 成功返回SDK_OK，失败返回错误码
+     */
+    int set_event_callback(uint8_t cmd, std::function<void(std::vector<uint8_t>)> callback);
+
+    /**
+     * @brief 获取回调执行器统计(队列深度, 回调耗时等)
+     * @param[out] stats 统计信息
+     * @return 成功返回SDK_OK，失败返回错误码
+     */
+    int get_executor_stats(smartwin_executor_stats& stats);
+
+    /**
+     * @brief 获取命令的应答超时学习状态
+     * @param[in] cmd 命令字 @see CMD_LED_ON
+     * @param[out] info 超时配置, 往返时间p99, 学习超时及当前实际使用的超时
+     * @return 成功返回SDK_OK，失败返回错误码
+     */
+    int get_timeout_info(uint8_t cmd, smartwin_timeout_info& info);
+
+    /**
+     * @brief 设置命令的应答超时策略, 已学习的样本会被清空
+     * @param[in] cmd 命令字 @see CMD_LED_ON
+     * @param[in] config 默认超时, 学习上下限及p99倍数
+     * @return 成功返回SDK_OK，参数错误返回SDK_PARAMERR
+     */
+    int set_timeout_config(uint8_t cmd, const smartwin_timeout_config& config);
+
+    /**
+     * @brief 启用后台卡片在位检测
+     * 库在接收线程中自适应轮询, 通过事件队列输出SW_EVENT_MAG_SWIPE, SW_EVENT_IC_INSERT, SW_EVENT_IC_REMOVE,
+     * 需先调用event_get_fd()启用事件队列. 读卡器需已打开.
+     * @param[in] slots 检测对象 @see SW_PRESENCE_MAG, SW_PRESENCE_IC, 0表示停止检测
+     * @param[in] card_type IC卡类型 @see SDK_CARD_TYPE_CPU
+     * @param[in] card_seat IC卡座号 @see SDK_CARD_SEAT_STANDARD
+     * @return 成功返回SDK_OK，失败返回错误码
+     */
+    int presence_enable(uint8_t slots, uint8_t card_type = 0, uint8_t card_seat = 0);
+
+    /**
+     * @brief 后台卡片在位检测进入快速轮询, 在提示用户刷卡/插卡时调用
+     * @return 成功返回SDK_OK，失败返回错误码
+     */
+    int presence_boost();
+
+    /**
+     * @brief 注册命令字的接收帧分发方式
+     * 未注册的命令字按命令应答处理; 设置handler后帧交给handler处理, 不再入队.
+     * handler在接收线程中执行, 不能阻塞, 不能调用本类的同步命令接口
+     * @param[in] cmd 命令字
+     * @param[in] entry 帧类别, 队列, 入队策略, 事件解码函数和处理函数
+     * @return 成功返回SDK_OK，失败返回错误码
+     */
+    int register_frame_handler(uint8_t cmd, const smartwin_dispatch_entry& entry);
+
+    /**
+     * @brief 获取接收队列统计(容量, 深度, 丢弃数)
+     * @param[in] queue 队列 @see SW_QUEUE_RESPONSE, SW_QUEUE_KEY, SW_QUEUE_TOUCH, SW_QUEUE_SEARCH_CARD, SW_QUEUE_IC_STATUS, SW_QUEUE_EVENT
+     * @param[out] stats 统计信息
+     * @return 成功返回SDK_OK，参数错误返回SDK_PARAMERR
+     */
+    int get_queue_stats(uint8_t queue, smartwin_queue_stats& stats);
+
+    /**
+     * @brief 设置接收队列的容量和队列满时的处理策略
+     * 按键和触摸队列为无锁环形队列, 容量固定, 满时只能丢弃新元素, 不支持修改
+     * @param[in] queue 队列 @see SW_QUEUE_RESPONSE, SW_QUEUE_SEARCH_CARD, SW_QUEUE_IC_STATUS, SW_QUEUE_EVENT
+     * @param[in] capacity 容量
+     * @param[in] policy 处理策略 @see SW_OVERFLOW_DROP_OLDEST, SW_OVERFLOW_DROP_NEWEST, SW_OVERFLOW_COALESCE
+     * @return 成功返回SDK_OK，参数错误返回SDK_PARAMERR
+     */
+    int set_queue_config(uint8_t queue, uint32_t capacity, uint8_t policy);
+
+    /**
+     * @brief 获取主动上报事件的eventfd
+     * 按键/触控/寻卡/IC卡状态任一事件到达时该描述符可读, 可加入epoll_wait;
+     * 第一次调用时创建并开始缓存事件, 之后用event_drain()取出
+     * @return 文件描述符, 失败返回SDK_ERROR
+     */
+    int event_get_fd();
+
+    /**
+     * @brief 取出事件队列中缓存的所有事件并清除eventfd可读状态
+     * 事件队列是所有主动上报事件(含在位检测, 状态线, 链路事件)的副本, 不消费按键/触摸/寻卡缓存,
+     * 这些输入仍需由drain_events或各自的接口取出; 输入延迟只在取出缓存时统计, 本接口不统计
+     * @param[out] events 事件追加到该数组末尾
+     * @return 取出的事件数
+     */
+    int event_drain(std::vector<smartwin_event>& events);
+
+    /**
+     * @brief 一次取出所有待处理的按键, 触摸点和寻卡结果, 按接收时间排序
+     * 与keyboard_get_input, tp_drain_touch_events, search_card_get_status共用同一缓存, 取出后这些接口不再返回;
+     * 与event_drain的事件队列相互独立, 两者都使用时同一输入会各出现一次.
+     * 按键和触摸点无锁取出, 寻卡结果只加一次锁; 不需要调用event_get_fd().
+     * 触摸停止超过上报间隔时补一个SW_TOUCH_UP点(timestamp_us为发现抬起的时间, rx_start_us为0)
+     * @param[out] events 事件数组 @see SW_EVENT_KEY, SW_EVENT_TOUCH, SW_EVENT_SEARCH_CARD
+     * @param[in] max 数组长度
+     * @return 取出的事件数
+     */
+    int drain_events(smartwin_event* events, int max);
+
     int send_request_cmd(uint8_t cmd, std::vector<uint8_t> params);
     int recv_from_list(int8_t cmd, std::vector<uint8_t> &buf);
+    int recv_from_list(uint8_t cmd, std::vector<uint8_t> &buf, int timeout_ms, smartwin_cancel_token* token);
+    int recv_list_wait(uint8_t cmd, std::vector<uint8_t> &buf, int timeout_ms, smartwin_cancel_token* token);
 
     std::vector<uint8_t> lvar_to_vector(std::vector<uint8_t> buf);
     std::vector<uint8_t> llvar_to_vector(std::vector<uint8_t> buf);
@@ -214,6 +604,16 @@ public:
      */
     int keyboard_get_input(uint8_t& key);
 
+    /**
+     * @brief 读取键盘输入, 无按键时阻塞等待
+     * 按键缓存为单生产者单消费者队列, 同一时间只能有一个线程读取按键
+     * @param[out] key 按键
+     * @param[in] timeout_ms 等待时间 ms, 0表示不等待
+     * @param[out] timestamp_us 按键帧接收时间(单调时钟) us, 可为nullptr
+     * @return 成功返回SDK_OK，超时返回SDK_TIMEOUT
+     */
+    int keyboard_get_input(uint8_t& key, uint32_t timeout_ms, uint64_t* timestamp_us = nullptr);
+
     /**
      * @brief 设置打开关闭按键音 (命令字: 0x34)
      * @param[in] sound 按键音开关 @see SDK_KEYBOARD_SOUND_OFF, SDK_KEYBOARD_SOUND_ON
@@ -254,6 +654,35 @@ public:
      */
     int tp_get_touch_coordinate(uint32_t &x, uint32_t &y);
 
+    /**
+     * @brief 批量读取触摸点, 按上报顺序返回自上次读取以来的所有点
+     * 固件不上报触摸动作, 与上一点间隔超过3倍上报间隔视为按下,
+     * 读取时最后一点已超过该间隔未更新则补一个抬起点(时间戳为发现抬起的时间).
+     * 与tp_get_touch_coordinate共用缓存, 同一时间只能有一个线程读取
+     * @param[out] points 触摸点数组
+     * @param[in] max 数组容量
+     * @return 读取的点数
+     */
+    int tp_drain_touch_events(smartwin_touch_point* points, int max);
+
+    /**
+     * @brief 启用触摸上报间隔自适应
+     * 库统计应用读取触摸点的频率, 拖动中按读取间隔通过tp_set_parameter设置上报间隔,
+     * 停止触摸后切换到空闲间隔, 减少串口流量和接收线程开销. 有效区域沿用上次tp_set_parameter的设置
+     * @param[in] enable 是否启用
+     * @param[in] min_interval_ms 拖动时的最小上报间隔 ms
+     * @param[in] idle_interval_ms 空闲时的上报间隔 ms
+     * @return 成功返回SDK_OK，失败返回错误码
+     */
+    int tp_set_adaptive_rate(bool enable, uint32_t min_interval_ms = 10, uint32_t idle_interval_ms = 100);
+
+    /**
+     * @brief 获取触摸上报间隔自适应统计
+     * @param[out] stats 统计信息
+     * @return 成功返回SDK_OK，失败返回错误码
+     */
+    int get_touch_rate_stats(smartwin_touch_rate_stats& stats);
+
     /**
      * @brief 设置触控参数 (命令字: 0x3F)
      * @param[in] start_x 有效X起始坐标 
@@ -426,9 +855,11 @@ public:
      * @brief 单独寻卡报文 (命令字: 0x46)
      * @param[in] search_mode 寻卡方式,按位组合使用 @see SDK_SWIPE_CARD_HAND, SDK_SWIPE_CARD_MAG, SDK_SWIPE_CARD_ICC, SDK_SWIPE_CARD_RF
      * @param[in] timeout_ms 寻卡超时时间 ms
+     * @param[in] token 取消令牌, 取消后接收线程立即结束寻卡, search_card_get_status返回SDK_ESC, 可为nullptr;
+     *            在search_card_get_status返回SDK_ESC或调用search_card_stop之前须保持有效
      * @return 成功返回SDK_OK，失败返回错误码
      */
-    int search_card_start(uint8_t search_mode, uint32_t timeout_ms);
+    int search_card_start(uint8_t search_mode, uint32_t timeout_ms, smartwin_cancel_token* token = nullptr);
 
     /**
      * @brief 获取寻卡状态 (命令字: 0x47)
@@ -438,6 +869,92 @@ public:
      */
     int search_card_get_status(uint8_t &type, uint8_t &key);
 
+    /**
+     * @brief 等待寻卡结果, 结果上报后立即唤醒
+     * @param[in] timeout_ms 等待时间 ms
+     * @param[out] type 卡片类型
+     * @param[out] key 卡片密钥
+     * @return 返回寻卡结果码, 超时返回SDK_TIMEOUT, 取消返回SDK_ESC
+     */
+    int search_card_wait(uint32_t timeout_ms, uint8_t &type, uint8_t &key);
+
+    /**
+     * @brief 开始寻卡, 结果上报后在执行器线程中调用一次回调 (命令字: 0x46)
+     * @param[in] search_mode 寻卡方式,按位组合使用 @see SDK_SWIPE_CARD_HAND, SDK_SWIPE_CARD_MAG, SDK_SWIPE_CARD_ICC, SDK_SWIPE_CARD_RF
+     * @param[in] timeout_ms 寻卡超时时间 ms
+     * @param[in] callback 回调, 参数依次为寻卡结果码, 卡片类型, 卡片密钥
+     * @return 成功返回SDK_OK，失败返回错误码
+     */
+    int search_card_start_async(uint8_t search_mode, uint32_t timeout_ms, std::function<void(int, uint8_t, uint8_t)> callback);
+
+    /**
+     * @brief 获取寻卡结果从接收到唤醒等待者(或执行回调)的延迟直方图
+     * @param[out] hist 直方图快照
+     * @return 成功返回SDK_OK，失败返回错误码
+     */
+    int get_search_card_stats(smartwin_latency_histogram& hist);
+
+    /**
+     * @brief 获取按键/触摸输入的延迟直方图
+     * 每个按键和触摸点记录三个时间: 首字节读取, 帧接收完成, 应用从缓存取出(keyboard_get_input,
+     * tp_drain_touch_events, tp_get_touch_coordinate, drain_events), 每个输入只记录一次. 接收线程模式下首字节读取时间
+     * 不包含字节在串口缓冲中等待轮询(最长约20ms)的时间
+     * @param[in] source 来源 @see SW_LATENCY_KEY, SW_LATENCY_TOUCH
+     * @param[in] stage 阶段 @see SW_LATENCY_WIRE, SW_LATENCY_QUEUE, SW_LATENCY_TOTAL
+     * @param[out] hist 直方图快照
+     * @return 成功返回SDK_OK，参数错误返回SDK_PARAMERR
+     */
+    int get_input_latency(uint8_t source, uint8_t stage, smartwin_latency_histogram& hist);
+
+    /**
+     * @brief 清空按键/触摸输入的延迟直方图
+     */
+    void reset_input_latency();
+
+    /**
+     * @brief 调整串口超时模型
+     * 读写N字节的超时 = turnaround_ms + N * 字节时间 * margin_pct / 100, 字节时间由波特率和帧格式(8N1)计算.
+     * 默认turnaround_ms为50, margin_pct为200, 链路中断时约50ms内即可发现
+     * @param[in] turnaround_ms 固件处理及调度余量 ms
+     * @param[in] margin_pct 线路时间余量, 不小于100
+     * @return 成功返回SDK_OK，参数错误返回SDK_PARAMERR
+     */
+    int set_serial_timing(uint32_t turnaround_ms, uint32_t margin_pct);
+
+    /**
+     * @brief 获取当前串口超时模型
+     * @param[out] timing 超时模型
+     * @return 成功返回SDK_OK
+     */
+    int get_serial_timing(smartwin_serial_timing& timing);
+
+    /**
+     * @brief 串口是否使用io_uring收发 @see set_io_uring_mode
+     * @return true: io_uring, false: pselect+read/write
+     */
+    bool get_io_uring();
+
+    /**
+     * @brief 探测串口可用的最高波特率
+     * 从当前波特率开始按rates依次升高主机侧波特率, 每档发送8次获取设备型号(0x19)命令,
+     * 全部应答且无校验错误才进入下一档, 失败则退回上一档并停止. 探测通过的各档保存为回退梯度,
+     * 之后每秒统计一次帧校验错误, 错误率超过1%时在执行器中降一档.
+     * 安全芯片固件没有切换波特率的命令, 须先调用set_autobaud(true)声明设备支持自动波特率,
+     * 否则只验证当前波特率, 不升档也不回退
+     * @param[in] rates 候选波特率, 从低到高, 可以是非标准波特率
+     * @param[in] count 候选个数
+     * @param[out] baudrate 探测后使用的波特率
+     * @return 成功返回SDK_OK, 参数错误返回SDK_PARAMERR, 当前波特率下设备无应答返回SDK_ERROR
+     */
+    int link_probe_baudrate(const uint32_t* rates, int count, uint32_t& baudrate);
+
+    /**
+     * @brief 获取当前波特率, 回退梯度和回退次数
+     * @param[out] stats 状态
+     * @return 成功返回SDK_OK
+     */
+    int get_link_rate_stats(smartwin_link_rate_stats& stats);
+
     /**
      * @brief 结束寻卡 (命令字: 0x48)
      * @return 成功返回SDK_OK，失败返回错误码
@@ -460,9 +977,10 @@ public:
      * @brief 读取扫码数据 (命令字: 0x5C)
      * @param[in] timeout_ms 超时时间
      * @param[out] data 扫码数据
-     * @return 成功返回SDK_OK，失败返回错误码
+     * @param[in] token 取消令牌, 取消后立即返回SDK_ESC并关闭扫码, 可为nullptr
+     * @return 成功返回SDK_OK，取消返回SDK_ESC，失败返回错误码
      */
-    int scan_read_data(uint32_t timeout_ms, std::vector<uint8_t>& data);
+    int scan_read_data(uint32_t timeout_ms, std::vector<uint8_t>& data, smartwin_cancel_token* token = nullptr);
 
     /**
      * @brief 检查是否支持打印机 (命令字: 0x61)
@@ -603,10 +1121,12 @@ public:
      * @param[in] 加密方式
      * @param[in] 等待输入时间
      * @param[out] 输入的密文PIN
-     * @return 成功返回SDK_OK，失败返回错误码
+     * @param[in] token 取消令牌, 取消后立即返回SDK_ESC并关闭密码键盘, 可为nullptr
+     * @return 成功返回SDK_OK，取消返回SDK_ESC，失败返回错误码
      */
     int keypad_input_online_pin(uint32_t master_key_index, std::vector<uint8_t> pin_length, uint8_t row_number, uint8_t column_number, 
-        std::vector<uint8_t> card_number, uint8_t encryption_mode, uint32_t wait_input_time, std::vector<uint8_t>& encrypted_pin);
+        std::vector<uint8_t> card_number, uint8_t encryption_mode, uint32_t wait_input_time, std::vector<uint8_t>& encrypted_pin,
+        smartwin_cancel_token* token = nullptr);
 
     /**
      * @brief 生成RSA密钥对输出公钥(N+E) (命令字: 0x7B)
@@ -0,0 +1,113 @@
+#ifndef __SMARTWIN_DISPATCH_H__
+#define __SMARTWIN_DISPATCH_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include "smartwin_event.h"
+
+/**
+ * @brief 帧类别, 按位组合使用
+ */
+#define SW_FRAME_RESPONSE       (0x01)      /**< 命令应答 */
+#define SW_FRAME_EVENT          (0x02)      /**< 主动上报, 解码后进入事件队列 */
+
+/**
+ * @brief 接收队列
+ */
+#define SW_QUEUE_NONE           (0x00)      /**< 不入队, 只调用处理函数 */
+#define SW_QUEUE_RESPONSE       (0x01)      /**< 命令应答队列 */
+#define SW_QUEUE_KEY            (0x02)      /**< 按键队列 */
+#define SW_QUEUE_TOUCH          (0x03)      /**< 触摸点队列 */
+#define SW_QUEUE_SEARCH_CARD    (0x04)      /**< 寻卡结果队列 */
+#define SW_QUEUE_IC_STATUS      (0x05)      /**< IC卡状态队列 */
+#define SW_QUEUE_EVENT          (0x06)      /**< 解码后的事件队列, 不能作为分发目标 */
+#define SW_QUEUE_COUNT          (0x07)
+
+/**
+ * @brief 入队策略
+ */
+#define SW_POLICY_KEEP_ALL      (0x00)      /**< 保留所有帧 */
+#define SW_POLICY_KEEP_LATEST   (0x01)      /**< 只保留最新一帧 */
+
+namespace smartwin {
+
+/**
+ * @brief 帧解码函数, 将主动上报帧解码为事件
+ * @return 解码成功返回true
+ */
+typedef bool (*smartwin_frame_decoder)(const std::vector<uint8_t>& buf, smartwin_event& ev);
+
+/**
+ * @brief 帧处理函数, 在接收线程中执行, 不能阻塞
+ */
+typedef std::function<void(const std::vector<uint8_t>& buf)> smartwin_frame_handler;
+
+/**
+ * @brief 队列入队函数
+ */
+typedef std::function<void(const std::vector<uint8_t>& buf, uint8_t policy)> smartwin_queue_sink;
+
+/**
+ * @brief 命令字分发表项
+ */
+struct smartwin_dispatch_entry {
+    uint8_t kind;                       /**< 帧类别 @see SW_FRAME_RESPONSE, SW_FRAME_EVENT */
+    uint8_t queue;                      /**< 接收队列 @see SW_QUEUE_RESPONSE */
+    uint8_t policy;                     /**< 入队策略 @see SW_POLICY_KEEP_ALL, SW_POLICY_KEEP_LATEST */
+    smartwin_frame_decoder decoder;     /**< 事件解码函数, 可为nullptr */
+    smartwin_frame_handler handler;     /**< 处理函数, 设置后代替入队 */
+};
+
+/**
+ * @brief 按命令字索引的帧分发表
+ * 256项, 每帧一次下标访问即可找到类别, 队列, 策略和解码函数.
+ * 表项为不可变对象, 注册时整体替换指针, 分发时不加锁;
+ * 被替换的旧表项在析构时释放.
+ */
+class smartwin_dispatcher {
+
+private:
+    std::atomic<const smartwin_dispatch_entry*> table_[256];
+    smartwin_queue_sink queues_[SW_QUEUE_COUNT];
+
+    pthread_mutex_t retired_mutex_;
+    std::vector<const smartwin_dispatch_entry*> retired_;
+
+public:
+    smartwin_dispatcher();
+    ~smartwin_dispatcher();
+
+    /**
+     * @brief 设置队列的入队函数, 须在开始接收前设置
+     */
+    void set_queue(uint8_t queue, smartwin_queue_sink sink);
+
+    /**
+     * @brief 注册命令字的分发表项, 可在运行中调用
+     */
+    void set_entry(uint8_t cmd, const smartwin_dispatch_entry& entry);
+
+    /**
+     * @brief 获取命令字的分发表项
+     */
+    const smartwin_dispatch_entry& get_entry(uint8_t cmd) const;
+
+    /**
+     * @brief 分发一帧: 调用处理函数或按策略入队
+     * @return 帧的分发表项, 供调用者解码事件
+     */
+    const smartwin_dispatch_entry& dispatch(const std::vector<uint8_t>& buf);
+};
+
+bool smartwin_decode_key(const std::vector<uint8_t>& buf, smartwin_event& ev);
+// 只解码坐标, 固件不上报触摸动作, action固定为SW_TOUCH_MOVE, 由调用者按上报间隔判断
+bool smartwin_decode_touch(const std::vector<uint8_t>& buf, smartwin_event& ev);
+bool smartwin_decode_search_card(const std::vector<uint8_t>& buf, smartwin_event& ev);
+bool smartwin_decode_ic_status(const std::vector<uint8_t>& buf, smartwin_event& ev);
+
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef __SMARTWIN_EVENT_H__
+#define __SMARTWIN_EVENT_H__
+
+#include <stdint.h>
+
+/**
+ * @brief 主动上报事件类型
+ */
+#define SW_EVENT_NONE           (0x00)      /**< 无效事件 */
+#define SW_EVENT_KEY            (0x01)      /**< 按键 (命令字: 0x32) */
+#define SW_EVENT_TOUCH          (0x02)      /**< 触控坐标 (命令字: 0x3E) */
+#define SW_EVENT_SEARCH_CARD    (0x03)      /**< 寻卡结果 (命令字: 0x46) */
+#define SW_EVENT_IC_STATUS      (0x04)      /**< IC卡状态 (命令字: 0x4C) */
+#define SW_EVENT_MAG_SWIPE      (0x05)      /**< 检测到刷磁条卡 @see SW_PRESENCE_MAG */
+#define SW_EVENT_IC_INSERT      (0x06)      /**< 检测到插入IC卡 @see SW_PRESENCE_IC */
+#define SW_EVENT_IC_REMOVE      (0x07)      /**< 检测到拔出IC卡 @see SW_PRESENCE_IC */
+#define SW_EVENT_MODEM          (0x08)      /**< 串口状态线变化 @see smartwin_devices::set_link_monitor */
+#define SW_EVENT_LINK           (0x09)      /**< 串口断开或重连成功 @see smartwin_devices::set_reconnect */
+
+/**
+ * @brief 串口状态线
+ */
+#define SW_MODEM_CTS            (0x01)      /**< CTS */
+#define SW_MODEM_DSR            (0x02)      /**< DSR */
+#define SW_MODEM_RI             (0x04)      /**< RI */
+#define SW_MODEM_CD             (0x08)      /**< CD */
+
+/**
+ * @brief 触摸动作
+ */
+#define SW_TOUCH_DOWN           (0x00)      /**< 按下 */
+#define SW_TOUCH_UP             (0x01)      /**< 抬起 */
+#define SW_TOUCH_MOVE           (0x02)      /**< 移动 */
+
+namespace smartwin {
+
+/**
+ * @brief 解码后的主动上报事件
+ */
+struct smartwin_event {
+    uint8_t type;                   /**< 事件类型 @see SW_EVENT_KEY, SW_EVENT_TOUCH, SW_EVENT_SEARCH_CARD, SW_EVENT_IC_STATUS, SW_EVENT_MAG_SWIPE, SW_EVENT_IC_INSERT, SW_EVENT_IC_REMOVE, SW_EVENT_MODEM, SW_EVENT_LINK */
+    uint64_t timestamp_us;          /**< 帧接收完成时间(单调时钟), 单位: us */
+    uint64_t rx_start_us;           /**< 帧首字节读取时间(单调时钟), 单位: us, 非串口帧产生的事件为0 */
+    union {
+        struct {
+            uint8_t code;           /**< 按键值 @see KEY_0 */
+        } key;
+        struct {
+            uint16_t x;             /**< X坐标 0~319, 原点左上角 */
+            uint16_t y;             /**< Y坐标 0~239, 原点左上角 */
+            uint8_t action;         /**< 触摸动作 @see SW_TOUCH_DOWN, SW_TOUCH_UP, SW_TOUCH_MOVE */
+        } touch;
+        struct {
+            int32_t result;         /**< 寻卡结果码 */
+            uint8_t card_type;      /**< 卡类型 */
+            uint8_t key;            /**< 手动寻卡时的按键值 */
+        } search_card;
+        struct {
+            int32_t status;         /**< IC卡状态 */
+        } ic;
+        struct {
+            uint8_t card_type;      /**< IC卡类型 */
+            uint8_t card_seat;      /**< IC卡座号 */
+        } presence;
+        struct {
+            uint8_t lines;          /**< 变化后有效的状态线 @see SW_MODEM_CTS */
+            uint8_t changed;        /**< 自上次事件以来有过跳变的状态线, 包括已恢复原电平的短脉冲 */
+            uint8_t link_up;        /**< 监视的状态线是否全部有效(安全芯片在线) */
+        } modem;
+        struct {
+            uint8_t up;             /**< 0: 串口断开, 1: 已重新打开 */
+            uint32_t down_ms;       /**< 重新打开时为断开时长, 单位: ms */
+            uint32_t reconnects;    /**< 累计重连次数 */
+        } link;
+    };
+};
+
+/**
+ * @brief 触摸点
+ */
+struct smartwin_touch_point {
+    uint16_t x;                     /**< X坐标 0~319, 原点左上角 */
+    uint16_t y;                     /**< Y坐标 0~239, 原点左上角 */
+    uint8_t action;                 /**< 触摸动作 @see SW_TOUCH_DOWN, SW_TOUCH_UP, SW_TOUCH_MOVE */
+    uint64_t timestamp_us;          /**< 帧接收完成时间(单调时钟), 单位: us */
+    uint64_t rx_start_us;           /**< 帧首字节读取时间(单调时钟), 单位: us, 非串口帧产生的事件为0 */
+};
+
+/**
+ * @brief 按键事件
+ */
+struct smartwin_key_event {
+    uint8_t code;                   /**< 按键值 @see KEY_0 */
+    uint64_t timestamp_us;          /**< 帧接收完成时间(单调时钟), 单位: us */
+    uint64_t rx_start_us;           /**< 帧首字节读取时间(单调时钟), 单位: us, 非串口帧产生的事件为0 */
+};
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef __SMARTWIN_EXECUTOR_H__
+#define __SMARTWIN_EXECUTOR_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <deque>
+#include <map>
+#include <vector>
+#include <functional>
+
+namespace smartwin {
+
+/**
+ * @brief 回调执行器统计
+ */
+struct smartwin_executor_stats {
+    uint32_t queue_depth;           /**< 当前排队的回调数 */
+    uint32_t max_queue_depth;       /**< 排队数历史最大值 */
+    uint64_t submitted;             /**< 提交的回调数 */
+    uint64_t executed;              /**< 已执行的回调数 */
+    uint64_t dropped;               /**< 队列满被丢弃的回调数 */
+    uint64_t callback_time_total_us;/**< 回调累计耗时, 单位: us */
+    uint32_t callback_time_max_us;  /**< 单次回调最大耗时, 单位: us */
+};
+
+/**
+ * @brief 有界回调执行器
+ * 用户回调不在接收线程内执行, 而是投递到少量工作线程.
+ * 相同key(事件类型)的回调固定投递到同一条通道, 保证按到达顺序执行; key可用bind()指定通道,
+ * 未指定的按哈希分配. 每条通道的排队数有上限, 满时丢弃新回调并计数, 一条通道积压不影响其他通道,
+ * 接收线程永不阻塞. workers为0时不创建线程, 由调用者通过run_pending()执行(无线程模式).
+ */
+class smartwin_executor {
+
+private:
+    struct lane {
+        pthread_t thread;
+        pthread_cond_t cond;
+        std::deque<std::function<void()>> tasks;
+        smartwin_executor* owner;
+    };
+
+    pthread_mutex_t mutex_;
+    std::vector<lane*> lanes_;
+    std::map<uint32_t, size_t> bindings_;   // key -> 通道
+    size_t capacity_;                       // 每条通道的容量
+    size_t depth_ = 0;
+    bool running_ = false;
+    bool in_run_pending_ = false;
+
+    smartwin_executor_stats stats_;
+
+    void execute(std::function<void()>& task);
+    lane* lane_for(uint32_t key);
+    static void* worker_func(void* arg);
+
+public:
+    /**
+     * @param[in] workers 工作线程数, 每个线程一条通道
+     * @param[in] capacity 每条通道的排队上限
+     */
+    smartwin_executor(int workers, size_t capacity);
+    ~smartwin_executor();
+
+    /**
+     * @brief 把key固定到指定通道, 投递前设置
+     * @param[in] key 排序键
+     * @param[in] lane 通道号, 超出通道数时取模
+     */
+    void bind(uint32_t key, size_t lane);
+
+    /**
+     * @brief 投递回调
+     * @param[in] key 排序键, 相同key按投递顺序执行
+     * @param[in] task 回调
+     * @return 成功返回SDK_OK, 所在通道满返回SDK_ERROR
+     */
+    int post(uint32_t key, std::function<void()> task);
+
+    /**
+     * @brief 在调用者线程执行所有排队的回调(workers为0时使用)
+     * @return 执行的回调数
+     */
+    int run_pending();
+
+    void get_stats(smartwin_executor_stats& stats);
+};
+
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef __SMARTWIN_LATENCY_H__
+#define __SMARTWIN_LATENCY_H__
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief 输入延迟来源
+ */
+#define SW_LATENCY_KEY          (0x00)      /**< 按键 */
+#define SW_LATENCY_TOUCH        (0x01)      /**< 触摸点 */
+#define SW_LATENCY_SOURCE_COUNT (2)
+
+/**
+ * @brief 输入延迟阶段
+ */
+#define SW_LATENCY_WIRE         (0x00)      /**< 首字节读取 -> 帧接收完成 */
+#define SW_LATENCY_QUEUE        (0x01)      /**< 帧接收完成 -> 应用取出 */
+#define SW_LATENCY_TOTAL        (0x02)      /**< 首字节读取 -> 应用取出 */
+#define SW_LATENCY_STAGE_COUNT  (3)
+
+/**
+ * @brief 直方图桶数, 第i个桶统计[2^i, 2^(i+1)) us, 第0个桶包含0
+ */
+#define SW_LATENCY_BUCKETS      (24)
+
+namespace smartwin {
+
+/**
+ * @brief 延迟直方图快照
+ */
+struct smartwin_latency_histogram {
+    uint32_t count;                         /**< 样本数 */
+    uint32_t min_us;                        /**< 最小延迟, 单位: us */
+    uint32_t max_us;                        /**< 最大延迟, 单位: us */
+    uint64_t total_us;                      /**< 累计延迟, 单位: us */
+    uint32_t p50_us;                        /**< 中位数所在桶的上限, 单位: us */
+    uint32_t p99_us;                        /**< p99所在桶的上限, 单位: us */
+    uint32_t buckets[SW_LATENCY_BUCKETS];   /**< 各桶样本数 */
+};
+
+/**
+ * @brief 无锁延迟直方图
+ * record可在任意线程调用, 只做几次relaxed原子操作; snapshot与record并发时各字段可能相差几个样本.
+ */
+class smartwin_latency_recorder {
+
+private:
+    std::atomic<uint32_t> min_us_;
+    std::atomic<uint32_t> max_us_;
+    std::atomic<uint64_t> total_us_;
+    std::atomic<uint32_t> buckets_[SW_LATENCY_BUCKETS];
+
+public:
+    smartwin_latency_recorder();
+
+    smartwin_latency_recorder(const smartwin_latency_recorder&) = delete;
+    smartwin_latency_recorder& operator=(const smartwin_latency_recorder&) = delete;
+
+    /**
+     * @brief 记录一个样本
+     * @param[in] latency_us 延迟 us
+     */
+    void record(uint64_t latency_us);
+
+    /**
+     * @brief 记录start_us到end_us的延迟, 任一时间戳为0或顺序颠倒时忽略
+     */
+    void record(uint64_t start_us, uint64_t end_us) {
+        if(start_us != 0 && end_us >= start_us) {
+            record(end_us - start_us);
+        }
+    }
+
+    void snapshot(smartwin_latency_histogram& hist) const;
+
+    void reset();
+};
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __SMARTWIN_LINK_RATE_H__
+#define __SMARTWIN_LINK_RATE_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+
+#define SW_LINK_RATE_MAX        (8)         /**< 已验证波特率的最大个数 */
+
+namespace smartwin {
+
+/**
+ * @brief 串口波特率状态
+ */
+struct smartwin_link_rate_stats {
+    uint32_t baudrate;                      /**< 当前波特率 */
+    uint32_t rate_count;                    /**< 已验证的波特率个数 */
+    uint32_t rates[SW_LINK_RATE_MAX];       /**< 已验证的波特率, 从低到高 */
+    uint32_t fallbacks;                     /**< 因校验错误回退的次数 */
+    uint32_t window_ok;                     /**< 当前统计窗口内校验通过的帧数 */
+    uint32_t window_bad;                    /**< 当前统计窗口内校验失败的帧数 */
+};
+
+/**
+ * @brief 串口波特率回退控制器
+ * 保存启动探测时验证过的波特率(从低到高), 每WINDOW_MS统计一次帧校验结果,
+ * 错误帧不少于MIN_BAD且错误率超过ERROR_PCT时降到上一档.
+ * tick在接收线程或process()中调用.
+ */
+class smartwin_link_rate {
+
+public:
+    static const uint32_t WINDOW_MS = 1000;
+    static const uint32_t MIN_BAD = 3;
+    static const uint32_t ERROR_PCT = 1;
+
+private:
+    pthread_mutex_t mutex_;
+    std::vector<uint32_t> rates_;
+    size_t index_ = 0;
+    uint32_t fallbacks_ = 0;
+
+    uint64_t window_start_ms_ = 0;
+    uint32_t base_ok_ = 0;
+    uint32_t base_bad_ = 0;
+    uint32_t window_ok_ = 0;
+    uint32_t window_bad_ = 0;
+
+public:
+    smartwin_link_rate();
+    ~smartwin_link_rate();
+
+    /**
+     * @brief 设置已验证的波特率, 当前使用最高一档
+     * @param[in] rates 从低到高
+     * @param[in] ok 当前累计的校验通过帧数
+     * @param[in] bad 当前累计的校验失败帧数
+     */
+    void set_rates(const std::vector<uint32_t>& rates, uint32_t ok, uint32_t bad);
+
+    /**
+     * @brief 按累计帧数判断是否需要回退
+     * @param[in] now_ms 当前时间
+     * @param[in] ok 累计校验通过帧数
+     * @param[in] bad 累计校验失败帧数
+     * @return 需要切换的波特率, 不需要返回0
+     */
+    uint32_t tick(uint64_t now_ms, uint32_t ok, uint32_t bad);
+
+    void get_stats(smartwin_link_rate_stats& stats);
+};
+
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef __SMARTWIN_LVGL_H__
+#define __SMARTWIN_LVGL_H__
+
+#ifdef SMARTWIN_LVGL
+
+#include <stdint.h>
+#include "lvgl.h"
+#include "smartwin_latency.h"
+
+namespace smartwin {
+
+/**
+ * @brief LVGL键盘输入设备读回调(LV_INDEV_TYPE_KEYPAD)
+ * 从按键缓存取按键, 不阻塞不加锁; 每个按键先报按下再报释放,
+ * 缓存中还有按键时置continue_reading, 一次刷新内交付全部按键.
+ * 使用后应用不能再调用keyboard_get_input.
+ *
+ * lv_indev_drv_t drv;
+ * lv_indev_drv_init(&drv);
+ * drv.type = LV_INDEV_TYPE_KEYPAD;
+ * drv.read_cb = smartwin::smartwin_lvgl_keypad_read;
+ * lv_indev_drv_register(&drv);
+ */
+void smartwin_lvgl_keypad_read(lv_indev_drv_t* drv, lv_indev_data_t* data);
+
+/**
+ * @brief LVGL触摸输入设备读回调(LV_INDEV_TYPE_POINTER)
+ * 从触摸点缓存取点, 不阻塞不加锁; 缓存中还有点时置continue_reading,
+ * 一次刷新内交付全部触摸点. 使用后应用不能再调用tp_drain_touch_events/tp_get_touch_coordinate.
+ */
+void smartwin_lvgl_pointer_read(lv_indev_drv_t* drv, lv_indev_data_t* data);
+
+/**
+ * @brief 获取输入延迟直方图(帧接收完成到LVGL读取的时间)
+ * @param[out] keypad 键盘
+ * @param[out] pointer 触摸
+ */
+void smartwin_lvgl_get_stats(smartwin_latency_histogram& keypad, smartwin_latency_histogram& pointer);
+
+}
+
+#endif
+
+#endif
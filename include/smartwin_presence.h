@@ -0,0 +1,112 @@
+#ifndef __SMARTWIN_PRESENCE_H__
+#define __SMARTWIN_PRESENCE_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include "smartwin_event.h"
+
+/**
+ * @brief 卡片在位检测对象, 按位组合使用
+ */
+#define SW_PRESENCE_MAG         (0x01)      /**< 磁条卡刷卡检测 (命令字: 0x42) */
+#define SW_PRESENCE_IC          (0x02)      /**< IC卡插拔检测 (命令字: 0x4C) */
+
+namespace smartwin {
+
+/**
+ * @brief 后台卡片在位检测
+ * 在接收线程(无线程模式下在process())中按自适应间隔发送检测命令:
+ * 读卡器打开或调用boost()后快速轮询, 空闲时间隔逐步加倍直到慢速间隔.
+ * 应用有请求在等待应答时不发送, 检测应答由本模块消费, 不进入应答队列;
+ * 只在状态变化时输出刷卡/插卡/拔卡事件.
+ */
+class smartwin_presence {
+
+public:
+    static const uint32_t FAST_INTERVAL_MS = 50;
+    static const uint32_t SLOW_INTERVAL_MS = 500;
+    static const uint32_t BOOST_WINDOW_MS = 3000;
+    static const uint32_t RESPONSE_TIMEOUT_MS = 500;
+
+private:
+    enum {
+        STATE_UNKNOWN = 0,
+        STATE_ABSENT,
+        STATE_PRESENT,
+    };
+
+    struct slot {
+        uint8_t cmd;
+        int state;
+        uint64_t next_due_ms;
+    };
+
+    pthread_mutex_t mutex_;
+
+    std::atomic<uint8_t> enabled_;
+    uint8_t card_type_ = 0;
+    uint8_t card_seat_ = 0;
+    slot mag_;
+    slot ic_;
+    bool ic_turn_ = false;          // 两个检测对象交替发送
+
+    uint32_t interval_ms_ = FAST_INTERVAL_MS;
+    uint64_t boost_until_ms_ = 0;
+
+    std::atomic<uint8_t> in_flight_;    // 已发送未应答的检测命令, 0表示无
+    uint64_t in_flight_deadline_ms_ = 0;
+
+    std::function<int(uint8_t, std::vector<uint8_t>)> send_;
+    std::function<bool()> busy_;
+    std::function<void(const smartwin_event&)> emit_;
+
+    void emit_edge(uint8_t type, uint8_t card_type, uint8_t card_seat);
+
+public:
+    /**
+     * @param[in] send 发送命令
+     * @param[in] busy 应用是否有请求在等待应答
+     * @param[in] emit 输出状态变化事件
+     */
+    smartwin_presence(std::function<int(uint8_t, std::vector<uint8_t>)> send,
+                      std::function<bool()> busy,
+                      std::function<void(const smartwin_event&)> emit);
+    ~smartwin_presence();
+
+    /**
+     * @brief 设置检测对象, 并进入快速轮询
+     * @param[in] slots 检测对象 @see SW_PRESENCE_MAG, SW_PRESENCE_IC, 0表示停止检测
+     * @param[in] card_type IC卡类型
+     * @param[in] card_seat IC卡座号
+     */
+    void enable(uint8_t slots, uint8_t card_type, uint8_t card_seat);
+
+    /**
+     * @brief 进入快速轮询(读卡器打开, 提示刷卡/插卡时调用)
+     */
+    void boost();
+
+    /**
+     * @brief 到期则发送一次检测命令, 在接收线程或process()中调用
+     */
+    void tick();
+
+    /**
+     * @brief 处理接收帧
+     * @return 帧为检测命令的应答并已消费返回true
+     */
+    bool on_response(const std::vector<uint8_t>& buf);
+
+    /**
+     * @brief 距下一次检测的时间
+     * @return 剩余毫秒数, 未启用返回-1
+     */
+    int get_timeout();
+};
+
+}
+
+#endif
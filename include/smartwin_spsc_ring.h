@@ -0,0 +1,92 @@
+#ifndef __SMARTWIN_SPSC_RING_H__
+#define __SMARTWIN_SPSC_RING_H__
+
+#include <stddef.h>
+#include <atomic>
+
+namespace smartwin {
+
+/**
+ * @brief 单生产者单消费者无锁环形队列
+ * 固定容量N(必须为2的幂), 入队出队均为O(1)且不分配内存.
+ * push只能在一个线程(接收线程)调用, pop/clear只能在另一个线程调用.
+ */
+template <typename T, size_t N>
+class smartwin_spsc_ring {
+
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "smartwin_spsc_ring: N must be a power of 2");
+
+private:
+    T items_[N];
+    alignas(64) std::atomic<size_t> head_;     // 生产者写
+    alignas(64) std::atomic<size_t> tail_;     // 消费者写
+
+public:
+    smartwin_spsc_ring() : head_(0), tail_(0) {}
+
+    smartwin_spsc_ring(const smartwin_spsc_ring&) = delete;
+    smartwin_spsc_ring& operator=(const smartwin_spsc_ring&) = delete;
+
+    /**
+     * @brief 入队(生产者)
+     * @return 成功返回true, 队列满返回false
+     */
+    bool push(const T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if(head - tail_.load(std::memory_order_acquire) >= N) {
+            return false;
+        }
+        items_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 出队(消费者)
+     * @return 成功返回true, 队列空返回false
+     */
+    bool pop(T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if(tail == head_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 读取队头元素但不出队(消费者)
+     * @return 成功返回true, 队列空返回false
+     */
+    bool peek(T& item) const {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if(tail == head_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items_[tail & (N - 1)];
+        return true;
+    }
+
+    /**
+     * @brief 丢弃所有已入队元素(消费者)
+     */
+    void clear() {
+        tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    bool empty() const {
+        return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+    }
+
+    size_t size() const {
+        size_t tail = tail_.load(std::memory_order_acquire);
+        return head_.load(std::memory_order_acquire) - tail;
+    }
+
+    static constexpr size_t capacity() { return N; }
+};
+
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef __SMARTWIN_TIME_H__
+#define __SMARTWIN_TIME_H__
+
+#include <stdint.h>
+#include <time.h>
+
+namespace smartwin {
+
+/**
+ * @brief 单调时钟, 单位: us
+ */
+static inline uint64_t smartwin_now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/**
+ * @brief 单调时钟, 单位: ms
+ */
+static inline uint64_t smartwin_now_ms() {
+    return smartwin_now_us() / 1000ULL;
+}
+
+}
+
+#endif
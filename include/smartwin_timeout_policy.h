@@ -0,0 +1,103 @@
+#ifndef __SMARTWIN_TIMEOUT_POLICY_H__
+#define __SMARTWIN_TIMEOUT_POLICY_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+namespace smartwin {
+
+/**
+ * @brief 单条命令的超时配置
+ */
+struct smartwin_timeout_config {
+    uint32_t default_ms;            /**< 样本不足时使用的超时, 单位: ms */
+    uint32_t min_ms;                /**< 学习超时下限, 单位: ms */
+    uint32_t max_ms;                /**< 学习超时上限, 单位: ms */
+    uint32_t factor;                /**< 学习超时 = factor * p99 */
+};
+
+/**
+ * @brief 单条命令的超时学习状态
+ */
+struct smartwin_timeout_info {
+    smartwin_timeout_config config; /**< 当前配置 */
+    uint32_t samples;               /**< 窗口内的往返时间样本数 */
+    uint32_t p99_us;                /**< 窗口内往返时间p99, 单位: us */
+    uint32_t learned_ms;            /**< 学习得到的超时, 样本不足时为0 */
+    uint32_t timeout_ms;            /**< 实际使用的超时, 单位: ms */
+};
+
+/**
+ * @brief 按命令字的自适应应答超时
+ * 初始使用默认表, 每条命令记录最近SAMPLE_WINDOW次往返时间,
+ * 样本足够后超时收敛到factor倍p99, 并限制在[min_ms, max_ms]内.
+ * 超时未应答时按已等待时长记一个样本, 使过紧的超时自动放宽.
+ * 处理时间取决于数据长度的命令(APDU, 打印位图, 加解密, 文件下载)不学习, 始终使用默认超时.
+ */
+class smartwin_timeout_policy {
+
+public:
+    static const int SAMPLE_WINDOW = 64;
+    static const int MIN_SAMPLES = 8;
+
+private:
+    struct entry {
+        smartwin_timeout_config config;
+        uint32_t rtt_us[SAMPLE_WINDOW];
+        uint32_t count;
+        uint32_t next;
+        uint32_t p99_us;
+        uint32_t learned_ms;
+        bool fixed;             // 处理时间随数据长度变化, 不学习
+    };
+
+    pthread_mutex_t mutex_;
+    entry entries_[256];
+
+    void update(entry& e);
+    uint32_t current(const entry& e);
+
+public:
+    smartwin_timeout_policy();
+    ~smartwin_timeout_policy();
+
+    /**
+     * @brief 获取命令当前的应答超时
+     * @param[in] cmd 命令字
+     * @return 超时时间 ms
+     */
+    int get_timeout(uint8_t cmd);
+
+    /**
+     * @brief 记录一次成功应答的往返时间
+     * @param[in] cmd 命令字
+     * @param[in] rtt_us 往返时间 us
+     */
+    void record(uint8_t cmd, uint32_t rtt_us);
+
+    /**
+     * @brief 记录一次超时, 以已等待时长作为样本
+     * @param[in] cmd 命令字
+     * @param[in] waited_ms 已等待时间 ms
+     */
+    void record_timeout(uint8_t cmd, uint32_t waited_ms);
+
+    /**
+     * @brief 修改命令的超时配置, 并清空已学习的样本
+     * @param[in] cmd 命令字
+     * @param[in] config 超时配置
+     * @return 成功返回SDK_OK, 参数错误返回SDK_PARAMERR
+     */
+    int set_config(uint8_t cmd, const smartwin_timeout_config& config);
+
+    /**
+     * @brief 获取命令的超时学习状态
+     * @param[in] cmd 命令字
+     * @param[out] info 学习状态
+     */
+    void get_info(uint8_t cmd, smartwin_timeout_info& info);
+};
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef __SMARTWIN_TOUCH_RATE_H__
+#define __SMARTWIN_TOUCH_RATE_H__
+
+#include <stdint.h>
+#include <atomic>
+
+namespace smartwin {
+
+/**
+ * @brief 触摸上报间隔自适应统计
+ */
+struct smartwin_touch_rate_stats {
+    uint8_t enabled;                /**< 是否启用 */
+    uint32_t interval_ms;           /**< 当前下发的上报间隔, 单位: ms */
+    uint32_t drain_interval_ms;     /**< 应用每轮读取(一帧)的平均间隔, 单位: ms */
+    uint32_t changes;               /**< 重新下发上报间隔的次数 */
+};
+
+/**
+ * @brief 触摸上报间隔控制器
+ * 统计应用读取触摸点的频率: 应用每帧可能连续调用多次直到取空(如LVGL的continue_reading),
+ * 取空后的下一次调用算作新一帧, 按帧间隔而不是调用间隔统计.
+ * 拖动中按帧间隔设置上报间隔(不低于min_ms),
+ * 停止触摸后切换到idle_ms. 间隔变化超过25%且距上次下发超过HOLD_MS才重新下发,
+ * 避免频繁设置.
+ * note_point在接收线程调用, note_drain在读取触摸点的线程调用, tick在接收线程或process()中调用.
+ */
+class smartwin_touch_rate {
+
+public:
+    static const uint32_t HOLD_MS = 500;
+    static const uint32_t IDLE_AFTER_MS = 1000;
+
+private:
+    std::atomic<bool> enabled_;
+    std::atomic<uint32_t> min_ms_;
+    std::atomic<uint32_t> idle_ms_;
+
+    std::atomic<uint64_t> last_point_us_;       // 接收线程写
+    uint64_t last_frame_us_ = 0;                // 读取线程写: 本帧第一次读取的时间
+    bool in_frame_ = false;                     // 读取线程写: 本帧还未取空
+    std::atomic<uint32_t> drain_interval_ms_;   // 帧间隔的滑动平均
+
+    std::atomic<uint32_t> interval_ms_;         // 当前下发的间隔
+    std::atomic<bool> applying_;
+    uint64_t last_change_ms_ = 0;
+    std::atomic<uint32_t> changes_;
+
+public:
+    smartwin_touch_rate();
+
+    void enable(bool enable, uint32_t min_ms, uint32_t idle_ms);
+    bool is_enabled() const { return enabled_.load(); }
+
+    void note_point(uint64_t now_us);
+    /**
+     * @brief 记录一次读取
+     * @param[in] now_us 当前时间
+     * @param[in] count 取出的触摸点数
+     * @param[in] emptied 本次读取后缓存已空
+     */
+    void note_drain(uint64_t now_us, int count, bool emptied);
+
+    /**
+     * @brief 计算是否需要重新下发上报间隔
+     * @return 需要下发的间隔 ms, 不需要返回0; 返回非0后须调用applied()
+     */
+    uint32_t tick(uint64_t now_ms);
+
+    /**
+     * @brief 下发完成
+     * @param[in] interval_ms 下发的间隔
+     * @param[in] ok 是否成功
+     */
+    void applied(uint32_t interval_ms, bool ok);
+
+    /**
+     * @brief 应用直接调用tp_set_parameter时同步当前间隔
+     */
+    void set_interval(uint32_t interval_ms) { interval_ms_ = interval_ms; }
+
+    void get_stats(smartwin_touch_rate_stats& stats);
+};
+
+}
+
+#endif
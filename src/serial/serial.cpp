@@ -1,13 +1,7 @@
 /* Copyright 2012 William Woodall and John Harrison */
 #include <algorithm>
 
-#if !defined(_WIN32) && !defined(__OpenBSD__) && !defined(__FreeBSD__)
-# include <alloca.h>
-#endif
-
-#if defined (__MINGW32__)
-# define alloca __builtin_alloca
-#endif
+#include <string.h>
 
 #include "serial/serial.h"
 
@@ -34,40 +28,69 @@ using serial::flowcontrol_t;
 
 class Serial::ScopedReadLock {
 public:
-  ScopedReadLock(SerialImpl *pimpl) : pimpl_(pimpl) {
+  ScopedReadLock(SerialImpl *pimpl) : pimpl_(pimpl), ec_(NULL), owned_(true) {
     this->pimpl_->readLock();
   }
+  // Non-throwing variant for the noexcept paths: a lock failure is
+  // reported through ec and owned() is false.
+  ScopedReadLock(SerialImpl *pimpl, std::error_code &ec)
+   : pimpl_(pimpl), ec_(&ec), owned_(pimpl->readLock(ec)) {
+  }
   ~ScopedReadLock() {
-    this->pimpl_->readUnlock();
+    if (!owned_) {
+      return;
+    }
+    if (ec_) {
+      this->pimpl_->readUnlock(*ec_);
+    } else {
+      this->pimpl_->readUnlock();
+    }
   }
+  bool owned() const { return owned_; }
 private:
   // Disable copy constructors
   ScopedReadLock(const ScopedReadLock&);
   const ScopedReadLock& operator=(ScopedReadLock);
 
   SerialImpl *pimpl_;
+  std::error_code *ec_;
+  bool owned_;
 };
 
 class Serial::ScopedWriteLock {
 public:
-  ScopedWriteLock(SerialImpl *pimpl) : pimpl_(pimpl) {
+  ScopedWriteLock(SerialImpl *pimpl) : pimpl_(pimpl), ec_(NULL), owned_(true) {
     this->pimpl_->writeLock();
   }
+  ScopedWriteLock(SerialImpl *pimpl, std::error_code &ec)
+   : pimpl_(pimpl), ec_(&ec), owned_(pimpl->writeLock(ec)) {
+  }
   ~ScopedWriteLock() {
-    this->pimpl_->writeUnlock();
+    if (!owned_) {
+      return;
+    }
+    if (ec_) {
+      this->pimpl_->writeUnlock(*ec_);
+    } else {
+      this->pimpl_->writeUnlock();
+    }
   }
+  bool owned() const { return owned_; }
 private:
   // Disable copy constructors
   ScopedWriteLock(const ScopedWriteLock&);
   const ScopedWriteLock& operator=(ScopedWriteLock);
   SerialImpl *pimpl_;
+  std::error_code *ec_;
+  bool owned_;
 };
 
 Serial::Serial (const string &port, uint32_t baudrate, serial::Timeout timeout,
                 bytesize_t bytesize, parity_t parity, stopbits_t stopbits,
                 flowcontrol_t flowcontrol)
  : pimpl_(new SerialImpl (port, baudrate, bytesize, parity,
-                                           stopbits, flowcontrol))
+                                           stopbits, flowcontrol)),
+   rbuf_head_(0), rbuf_avail_(0)
 {
   pimpl_->setTimeout(timeout);
 }
@@ -87,6 +110,7 @@ void
 Serial::close ()
 {
   pimpl_->close ();
+  clearReadAhead_ ();
 }
 
 bool
@@ -98,12 +122,32 @@ Serial::isOpen () const
 size_t
 Serial::available ()
 {
-  return pimpl_->available ();
+  return rbuf_avail_ + pimpl_->available ();
+}
+
+size_t
+Serial::available (std::error_code &ec) noexcept
+{
+  size_t count = pimpl_->available (ec);
+  return rbuf_avail_ + count;
+}
+
+bool
+Serial::waitReadable (uint32_t timeout_ms, std::error_code &ec) noexcept
+{
+  ec.clear ();
+  if (rbuf_avail_ > 0) {
+    return true;
+  }
+  return pimpl_->waitReadable (timeout_ms, ec);
 }
 
 bool
 Serial::waitReadable ()
 {
+  if (rbuf_avail_ > 0) {
+    return true;
+  }
   serial::Timeout timeout(pimpl_->getTimeout ());
   return pimpl_->waitReadable(timeout.read_timeout_constant);
 }
@@ -114,54 +158,95 @@ Serial::waitByteTimes (size_t count)
   pimpl_->waitByteTimes(count);
 }
 
+size_t
+Serial::takeReadAhead_ (uint8_t *buffer, size_t size)
+{
+  // Serve bytes left over from a line read first
+  size_t buffered = min (rbuf_.size () - rbuf_head_, size);
+  if (buffered > 0) {
+    memcpy (buffer, &rbuf_[rbuf_head_], buffered);
+    consume_ (buffered);
+  }
+  return buffered;
+}
+
 size_t
 Serial::read_ (uint8_t *buffer, size_t size)
 {
-  return this->pimpl_->read (buffer, size);
+  size_t buffered = takeReadAhead_ (buffer, size);
+  if (buffered == size) {
+    return size;
+  }
+  return buffered + this->pimpl_->read (buffer + buffered, size - buffered);
+}
+
+size_t
+Serial::read (uint8_t *buffer, size_t size, std::error_code &ec) noexcept
+{
+  ec.clear ();
+  ScopedReadLock lock(this->pimpl_, ec);
+  if (!lock.owned ()) {
+    return 0;
+  }
+  size_t buffered = takeReadAhead_ (buffer, size);
+  if (buffered == size) {
+    return size;
+  }
+  return buffered + this->pimpl_->read (buffer + buffered, size - buffered, ec);
 }
 
 size_t
 Serial::read (uint8_t *buffer, size_t size)
 {
   ScopedReadLock lock(this->pimpl_);
-  return this->pimpl_->read (buffer, size);
+  return this->read_ (buffer, size);
 }
 
 size_t
 Serial::read (std::vector<uint8_t> &buffer, size_t size)
 {
   ScopedReadLock lock(this->pimpl_);
-  uint8_t *buffer_ = new uint8_t[size];
+  size_t old_size = buffer.size ();
+  buffer.resize (old_size + size);
   size_t bytes_read = 0;
 
   try {
-    bytes_read = this->pimpl_->read (buffer_, size);
+    bytes_read = this->read_ (buffer.data () + old_size, size);
   }
   catch (const std::exception &e) {
-    delete[] buffer_;
+    buffer.resize (old_size);
     throw;
   }
 
-  buffer.insert (buffer.end (), buffer_, buffer_+bytes_read);
-  delete[] buffer_;
+  buffer.resize (old_size + bytes_read);
   return bytes_read;
 }
 
+size_t
+Serial::read (byte_span buffer)
+{
+  if (buffer.size == 0) {
+    return 0;
+  }
+  ScopedReadLock lock(this->pimpl_);
+  return this->read_ (buffer.data, buffer.size);
+}
+
 size_t
 Serial::read (std::string &buffer, size_t size)
 {
   ScopedReadLock lock(this->pimpl_);
-  uint8_t *buffer_ = new uint8_t[size];
+  size_t old_size = buffer.size ();
+  buffer.resize (old_size + size);
   size_t bytes_read = 0;
   try {
-    bytes_read = this->pimpl_->read (buffer_, size);
+    bytes_read = this->read_ (reinterpret_cast<uint8_t*> (&buffer[old_size]), size);
   }
   catch (const std::exception &e) {
-    delete[] buffer_;
+    buffer.resize (old_size);
     throw;
   }
-  buffer.append (reinterpret_cast<const char*>(buffer_), bytes_read);
-  delete[] buffer_;
+  buffer.resize (old_size + bytes_read);
   return bytes_read;
 }
 
@@ -177,27 +262,7 @@ size_t
 Serial::readline (string &buffer, size_t size, string eol)
 {
   ScopedReadLock lock(this->pimpl_);
-  size_t eol_len = eol.length ();
-  uint8_t *buffer_ = static_cast<uint8_t*>
-                              (alloca (size * sizeof (uint8_t)));
-  size_t read_so_far = 0;
-  while (true)
-  {
-    size_t bytes_read = this->read_ (buffer_ + read_so_far, 1);
-    read_so_far += bytes_read;
-    if (bytes_read == 0) {
-      break; // Timeout occured on reading 1 byte
-    }
-    if (string (reinterpret_cast<const char*>
-         (buffer_ + read_so_far - eol_len), eol_len) == eol) {
-      break; // EOL found
-    }
-    if (read_so_far == size) {
-      break; // Reached the maximum read length
-    }
-  }
-  buffer.append(reinterpret_cast<const char*> (buffer_), read_so_far);
-  return read_so_far;
+  return this->readline_ (buffer, size, eol);
 }
 
 string
@@ -213,40 +278,118 @@ Serial::readlines (size_t size, string eol)
 {
   ScopedReadLock lock(this->pimpl_);
   std::vector<std::string> lines;
-  size_t eol_len = eol.length ();
-  uint8_t *buffer_ = static_cast<uint8_t*>
-    (alloca (size * sizeof (uint8_t)));
   size_t read_so_far = 0;
-  size_t start_of_line = 0;
   while (read_so_far < size) {
-    size_t bytes_read = this->read_ (buffer_+read_so_far, 1);
-    read_so_far += bytes_read;
+    std::string line;
+    size_t bytes_read = this->readline_ (line, size - read_so_far, eol);
     if (bytes_read == 0) {
-      if (start_of_line != read_so_far) {
-        lines.push_back (
-          string (reinterpret_cast<const char*> (buffer_ + start_of_line),
-            read_so_far - start_of_line));
-      }
-      break; // Timeout occured on reading 1 byte
+      break; // Timeout occured before any byte of the next line
+    }
+    read_so_far += bytes_read;
+    bool has_eol = eol.empty () || (line.size () >= eol.size ()
+        && line.compare (line.size () - eol.size (), eol.size (), eol) == 0);
+    lines.push_back (line);
+    if (!has_eol) {
+      break; // Timeout or maximum read length in the middle of a line
     }
-    if (string (reinterpret_cast<const char*>
-         (buffer_ + read_so_far - eol_len), eol_len) == eol) {
-      // EOL found
-      lines.push_back(
-        string(reinterpret_cast<const char*> (buffer_ + start_of_line),
-          read_so_far - start_of_line));
-      start_of_line = read_so_far;
+  }
+  return lines;
+}
+
+size_t
+Serial::fill_ ()
+{
+  static const size_t read_ahead = 4096;
+
+  if (rbuf_head_ == rbuf_.size ()) {
+    rbuf_.clear ();
+    rbuf_head_ = 0;
+  } else if (rbuf_head_ > read_ahead) {
+    rbuf_.erase (rbuf_.begin (), rbuf_.begin () + rbuf_head_);
+    rbuf_head_ = 0;
+  }
+
+  // Take everything that is already there in one call; if nothing is,
+  // block for a single byte so the port timeout still applies.
+  size_t want = std::max<size_t> (1, min (pimpl_->available (), read_ahead));
+  size_t old_size = rbuf_.size ();
+  rbuf_.resize (old_size + want);
+  size_t bytes_read = 0;
+  try {
+    bytes_read = pimpl_->read (&rbuf_[old_size], want);
+  }
+  catch (const std::exception &e) {
+    rbuf_.resize (old_size);
+    throw;
+  }
+  rbuf_.resize (old_size + bytes_read);
+  rbuf_avail_ = rbuf_.size () - rbuf_head_;
+  return bytes_read;
+}
+
+void
+Serial::consume_ (size_t count)
+{
+  rbuf_head_ += count;
+  rbuf_avail_ = rbuf_.size () - rbuf_head_;
+}
+
+void
+Serial::clearReadAhead_ ()
+{
+  rbuf_.clear ();
+  rbuf_head_ = 0;
+  rbuf_avail_ = 0;
+}
+
+size_t
+Serial::readline_ (string &buffer, size_t size, const string &eol)
+{
+  size_t eol_len = eol.length ();
+  size_t read_so_far = 0;
+
+  while (read_so_far < size) {
+    if (rbuf_head_ == rbuf_.size () && fill_ () == 0) {
+      break; // Timeout occured
     }
-    if (read_so_far == size) {
-      if (start_of_line != read_so_far) {
-        lines.push_back(
-          string(reinterpret_cast<const char*> (buffer_ + start_of_line),
-            read_so_far - start_of_line));
+
+    const char *data = reinterpret_cast<const char*> (&rbuf_[rbuf_head_]);
+    size_t len = min (rbuf_.size () - rbuf_head_, size - read_so_far);
+    size_t take = len;
+    bool eol_found = false;
+
+    if (eol_len == 0) {
+      take = 1;
+      eol_found = true;
+    } else if (eol_len == 1) {
+      const char *hit = static_cast<const char*> (memchr (data, eol[0], len));
+      if (hit != NULL) {
+        take = hit - data + 1;
+        eol_found = true;
+      }
+    } else {
+      // The EOL may straddle two chunks, so the search starts up to
+      // eol_len - 1 bytes back in the part of the line already read.
+      size_t back = min (read_so_far, eol_len - 1);
+      buffer.append (data, len);
+      const char *start = buffer.data () + buffer.size () - len - back;
+      const char *hit = static_cast<const char*>
+        (memmem (start, len + back, eol.data (), eol_len));
+      if (hit != NULL) {
+        take = hit - start + eol_len - back;
+        eol_found = true;
       }
-      break; // Reached the maximum read length
+      buffer.resize (buffer.size () - len);
+    }
+
+    buffer.append (data, take);
+    consume_ (take);
+    read_so_far += take;
+    if (eol_found) {
+      break;
     }
   }
-  return lines;
+  return read_so_far;
 }
 
 size_t
@@ -271,6 +414,46 @@ Serial::write (const uint8_t *data, size_t size)
   return this->write_(data, size);
 }
 
+size_t
+Serial::write (const uint8_t *data, size_t size, std::error_code &ec) noexcept
+{
+  ec.clear ();
+  ScopedWriteLock lock(this->pimpl_, ec);
+  if (!lock.owned ()) {
+    return 0;
+  }
+  return pimpl_->write (data, size, ec);
+}
+
+size_t
+Serial::writeAsync (const uint8_t *data, size_t size, std::error_code &ec) noexcept
+{
+  ec.clear ();
+  ScopedWriteLock lock(this->pimpl_, ec);
+  if (!lock.owned ()) {
+    return 0;
+  }
+  return pimpl_->writeAsync (data, size, ec);
+}
+
+size_t
+Serial::writePending () noexcept
+{
+  return pimpl_->writePending ();
+}
+
+bool
+Serial::takeWriteError (std::error_code &ec) noexcept
+{
+  return pimpl_->takeWriteError (ec);
+}
+
+bool
+Serial::waitWriteComplete (uint32_t timeout_ms, std::error_code &ec) noexcept
+{
+  return pimpl_->waitWriteComplete (timeout_ms, ec);
+}
+
 size_t
 Serial::write_ (const uint8_t *data, size_t length)
 {
@@ -365,6 +548,32 @@ Serial::getFlowcontrol () const
   return pimpl_->getFlowcontrol ();
 }
 
+void
+Serial::setLowLatency (bool enabled)
+{
+  pimpl_->setLowLatency (enabled);
+}
+
+bool
+Serial::getLowLatency () const
+{
+  return pimpl_->getLowLatency ();
+}
+
+bool
+Serial::setIoUring (bool enabled)
+{
+  ScopedReadLock rlock(this->pimpl_);
+  ScopedWriteLock wlock(this->pimpl_);
+  return pimpl_->setIoUring (enabled);
+}
+
+bool
+Serial::getIoUring () const
+{
+  return pimpl_->getIoUring ();
+}
+
 void Serial::flush ()
 {
   ScopedReadLock rlock(this->pimpl_);
@@ -375,6 +584,7 @@ void Serial::flush ()
 void Serial::flushInput ()
 {
   ScopedReadLock lock(this->pimpl_);
+  clearReadAhead_ ();
   pimpl_->flushInput ();
 }
 
@@ -409,6 +619,16 @@ bool Serial::waitForChange()
   return pimpl_->waitForChange();
 }
 
+bool Serial::startModemMonitor (const ModemCallback &callback)
+{
+  return pimpl_->startModemMonitor (callback);
+}
+
+void Serial::stopModemMonitor ()
+{
+  pimpl_->stopModemMonitor ();
+}
+
 bool Serial::getCTS ()
 {
   return pimpl_->getCTS ();
@@ -428,3 +648,8 @@ bool Serial::getCD ()
 {
   return pimpl_->getCD ();
 }
+
+int Serial::getFd () const
+{
+  return pimpl_->getFd ();
+}
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <sstream>
+#include <algorithm>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
@@ -23,6 +24,25 @@
 # include <linux/serial.h>
 #endif
 
+#if defined(__linux__) && defined (TCGETS2)
+// <asm/termbits.h> cannot be included next to <termios.h>, so declare the
+// kernel's termios2 (generic layout, as used on arm and x86) for the
+// TCGETS2/TCSETS2 ioctls that take an arbitrary baud rate.
+struct termios2 {
+  tcflag_t c_iflag;
+  tcflag_t c_oflag;
+  tcflag_t c_cflag;
+  tcflag_t c_lflag;
+  cc_t c_line;
+  cc_t c_cc[19];
+  speed_t c_ispeed;
+  speed_t c_ospeed;
+};
+# ifndef BOTHER
+#  define BOTHER 0010000
+# endif
+#endif
+
 #include <sys/select.h>
 #include <sys/time.h>
 #include <time.h>
@@ -105,16 +125,53 @@ timespec_from_ms (const uint32_t millis)
   return time;
 }
 
+#ifndef SERIAL_MODEM_WAKEUP_SIGNAL
+// Interrupts TIOCMIWAIT when the modem monitor is stopped. Define it to a
+// different signal at build time if the application uses SIGUSR2.
+# define SERIAL_MODEM_WAKEUP_SIGNAL SIGUSR2
+#endif
+
+static void
+modem_wakeup_handler (int)
+{
+}
+
+static uint64_t
+monotonic_us ()
+{
+  timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t> (ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t
+modem_lines (int status)
+{
+  uint32_t lines = 0;
+  if (status & TIOCM_CTS) lines |= serial::modem_cts;
+  if (status & TIOCM_DSR) lines |= serial::modem_dsr;
+  if (status & TIOCM_RNG) lines |= serial::modem_ri;
+  if (status & TIOCM_CD) lines |= serial::modem_cd;
+  return lines;
+}
+
 Serial::SerialImpl::SerialImpl (const string &port, unsigned long baudrate,
                                 bytesize_t bytesize,
                                 parity_t parity, stopbits_t stopbits,
                                 flowcontrol_t flowcontrol)
   : port_ (port), fd_ (-1), is_open_ (false), xonxoff_ (false), rtscts_ (false),
     baudrate_ (baudrate), parity_ (parity),
-    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol)
+    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol),
+    low_latency_ (false), low_latency_set_ (false),
+    tx_running_ (false), tx_stop_ (false), tx_head_ (0),
+    modem_running_ (false), modem_stop_ (false), modem_exited_ (false),
+    use_uring_ (false), uring_ (NULL)
 {
   pthread_mutex_init(&this->read_mutex, NULL);
   pthread_mutex_init(&this->write_mutex, NULL);
+  pthread_mutex_init(&this->tx_mutex_, NULL);
+  pthread_cond_init(&this->tx_cond_, NULL);
+  pthread_cond_init(&this->tx_empty_cond_, NULL);
   if (port_.empty () == false)
     open ();
 }
@@ -124,6 +181,9 @@ Serial::SerialImpl::~SerialImpl ()
   close();
   pthread_mutex_destroy(&this->read_mutex);
   pthread_mutex_destroy(&this->write_mutex);
+  pthread_mutex_destroy(&this->tx_mutex_);
+  pthread_cond_destroy(&this->tx_cond_);
+  pthread_cond_destroy(&this->tx_empty_cond_);
 }
 
 void
@@ -152,8 +212,21 @@ Serial::SerialImpl::open ()
     }
   }
 
-  reconfigurePort();
+  // A device that is still enumerating can fail configuration; don't leak
+  // the descriptor, the caller may retry open() many times.
+  try {
+    reconfigurePort();
+  } catch (...) {
+    ::close (fd_);
+    fd_ = -1;
+    throw;
+  }
   is_open_ = true;
+
+  if (use_uring_) {
+    uring_ = UringChannel::open (fd_);
+    applyWriteTimeout ();
+  }
 }
 
 void
@@ -314,7 +387,10 @@ Serial::SerialImpl::reconfigurePort ()
     if (-1 == ioctl (fd_, IOSSIOSPEED, &new_baud, 1)) {
       THROW (IOException, errno);
     }
-    // Linux Support
+    // Linux Support: termios2 takes the rate itself, see after tcsetattr
+    // below. The custom divisor is the fallback for older headers and only
+    // reaches rates that divide baud_base.
+#elif defined(__linux__) && defined (TCGETS2)
 #elif defined(__linux__) && defined (TIOCSSERIAL)
     struct serial_struct ser;
 
@@ -436,13 +512,36 @@ Serial::SerialImpl::reconfigurePort ()
   // http://www.unixwiz.net/techtips/termios-vmin-vtime.html
   // this basically sets the read call up to be a polling read,
   // but we are using select to ensure there is data available
-  // to read before each call, so we should never needlessly poll
+  // to read before each call, so we should never needlessly poll.
+  // The low latency profile keeps 0/0 on purpose: VMIN > 0 would make the
+  // pre-fill read in read() block (the fd is O_NONBLOCK anyway), and
+  // VTIME > 0 only adds an inter-byte wait in the line discipline, which
+  // is the delay the profile is meant to remove.
   options.c_cc[VMIN] = 0;
   options.c_cc[VTIME] = 0;
 
   // activate settings
   ::tcsetattr (fd_, TCSANOW, &options);
 
+#if defined(__linux__) && defined (TCGETS2)
+  if (custom_baud) {
+    // tcsetattr above has just written a standard rate, override it.
+    struct termios2 options2;
+    if (-1 == ioctl (fd_, TCGETS2, &options2)) {
+      THROW (IOException, errno);
+    }
+    options2.c_cflag &= (tcflag_t) ~CBAUD;
+    options2.c_cflag |= BOTHER;
+    options2.c_ispeed = static_cast<speed_t> (baudrate_);
+    options2.c_ospeed = static_cast<speed_t> (baudrate_);
+    if (-1 == ioctl (fd_, TCSETS2, &options2)) {
+      THROW (IOException, errno);
+    }
+  }
+#endif
+
+  applyLowLatency ();
+
   // Update byte_time_ based on the new settings.
   uint32_t bit_time_ns = 1e9 / baudrate_;
   byte_time_ns_ = bit_time_ns * (1 + bytesize_ + parity_ + stopbits_);
@@ -454,11 +553,70 @@ Serial::SerialImpl::reconfigurePort ()
   }
 }
 
+void
+Serial::SerialImpl::applyLowLatency ()
+{
+#if defined(__linux__) && defined (TIOCSSERIAL) && defined (ASYNC_LOW_LATENCY)
+  // Not every tty driver supports TIOCGSERIAL (e.g. pty, most USB adapters
+  // only partially), so failures here are not errors.
+  struct serial_struct ser;
+  if (ioctl (fd_, TIOCGSERIAL, &ser) == 0) {
+    bool on = (ser.flags & ASYNC_LOW_LATENCY) != 0;
+    if (low_latency_ && !on) {
+      ser.flags |= ASYNC_LOW_LATENCY;
+      low_latency_set_ = ioctl (fd_, TIOCSSERIAL, &ser) == 0;
+    } else if (!low_latency_ && on && low_latency_set_) {
+      ser.flags &= ~ASYNC_LOW_LATENCY;
+      ioctl (fd_, TIOCSSERIAL, &ser);
+      low_latency_set_ = false;
+    }
+  }
+#endif
+
+  // 8250/16550 drivers expose the RX FIFO interrupt threshold in sysfs.
+  if (rx_trig_path_.empty ()) {
+    string::size_type slash = port_.rfind ('/');
+    string name = slash == string::npos ? port_ : port_.substr (slash + 1);
+    rx_trig_path_ = "/sys/class/tty/" + name + "/rx_trig_bytes";
+  }
+  if (low_latency_ && rx_trig_saved_.empty ()) {
+    FILE *f = fopen (rx_trig_path_.c_str (), "r+");
+    if (f != NULL) {
+      char saved[16] = {0};
+      if (fgets (saved, sizeof (saved), f) != NULL) {
+        rewind (f);
+        if (fputs ("1", f) >= 0) {
+          rx_trig_saved_ = saved;
+        }
+      }
+      fclose (f);
+    }
+  } else if (!low_latency_ && !rx_trig_saved_.empty ()) {
+    FILE *f = fopen (rx_trig_path_.c_str (), "w");
+    if (f != NULL) {
+      fputs (rx_trig_saved_.c_str (), f);
+      fclose (f);
+    }
+    rx_trig_saved_.clear ();
+  }
+}
+
 void
 Serial::SerialImpl::close ()
 {
+  stopModemMonitor ();
+  txStop ();
+  // Requests in the ring reference fd_, so they go before the fd does.
+  delete uring_;
+  uring_ = NULL;
   if (is_open_ == true) {
     if (fd_ != -1) {
+      // Leave the driver as we found it for the next user of the port.
+      if (low_latency_) {
+        low_latency_ = false;
+        applyLowLatency ();
+        low_latency_ = true;
+      }
       int ret;
       ret = ::close (fd_);
       if (ret == 0) {
@@ -478,22 +636,42 @@ Serial::SerialImpl::isOpen () const
 }
 
 size_t
-Serial::SerialImpl::available ()
+Serial::SerialImpl::available (std::error_code &ec) noexcept
 {
+  ec.clear ();
   if (!is_open_) {
     return 0;
   }
+  if (uring_ != NULL) {
+    return uring_->available (ec);
+  }
   int count = 0;
   if (-1 == ioctl (fd_, TIOCINQ, &count)) {
-      THROW (IOException, errno);
+      ec.assign (errno, std::system_category ());
+      return 0;
   } else {
       return static_cast<size_t> (count);
   }
 }
 
+size_t
+Serial::SerialImpl::available ()
+{
+  std::error_code ec;
+  size_t count = available (ec);
+  if (ec) {
+    throwError (ec, "Serial::available");
+  }
+  return count;
+}
+
 bool
-Serial::SerialImpl::waitReadable (uint32_t timeout)
+Serial::SerialImpl::waitReadable (uint32_t timeout, std::error_code &ec) noexcept
 {
+  ec.clear ();
+  if (uring_ != NULL) {
+    return uring_->waitReadable (timeout, ec);
+  }
   // Setup a select call to block for serial data or a timeout
   fd_set readfds;
   FD_ZERO (&readfds);
@@ -507,7 +685,8 @@ Serial::SerialImpl::waitReadable (uint32_t timeout)
       return false;
     }
     // Otherwise there was some error
-    THROW (IOException, errno);
+    ec.assign (errno, std::system_category ());
+    return false;
   }
   // Timeout occurred
   if (r == 0) {
@@ -515,13 +694,24 @@ Serial::SerialImpl::waitReadable (uint32_t timeout)
   }
   // This shouldn't happen, if r > 0 our fd has to be in the list!
   if (!FD_ISSET (fd_, &readfds)) {
-    THROW (IOException, "select reports ready to read, but our fd isn't"
-           " in the list, this shouldn't happen!");
+    ec = std::make_error_code (std::errc::state_not_recoverable);
+    return false;
   }
   // Data available to read.
   return true;
 }
 
+bool
+Serial::SerialImpl::waitReadable (uint32_t timeout)
+{
+  std::error_code ec;
+  bool readable = waitReadable (timeout, ec);
+  if (ec) {
+    throwError (ec, "Serial::waitReadable");
+  }
+  return readable;
+}
+
 void
 Serial::SerialImpl::waitByteTimes (size_t count)
 {
@@ -530,19 +720,40 @@ Serial::SerialImpl::waitByteTimes (size_t count)
 }
 
 size_t
-Serial::SerialImpl::read (uint8_t *buf, size_t size)
+Serial::SerialImpl::read (uint8_t *buf, size_t size, std::error_code &ec) noexcept
 {
-  // If the port is not open, throw
+  ec.clear ();
   if (!is_open_) {
-    throw PortNotOpenedException ("Serial::read");
+    ec = std::make_error_code (std::errc::bad_file_descriptor);
+    return 0;
   }
   size_t bytes_read = 0;
 
-  // Calculate total timeout in milliseconds t_c + (t_m * N)
+  // Calculate total timeout in milliseconds t_c + (t_m * N) + (t_us * N) / 1000
   long total_timeout_ms = timeout_.read_timeout_constant;
   total_timeout_ms += timeout_.read_timeout_multiplier * static_cast<long> (size);
+  total_timeout_ms += static_cast<long> (
+      (static_cast<uint64_t> (timeout_.read_timeout_multiplier_us) * size + 999) / 1000);
   MillisecondTimer total_timeout(total_timeout_ms);
 
+  if (uring_ != NULL) {
+    // Input is already being read into the channel; copy from it, waiting
+    // on its completions with the same total and inter-byte timeouts.
+    bytes_read = uring_->read (buf, size, ec);
+    while (bytes_read < size && !ec) {
+      int64_t timeout_remaining_ms = total_timeout.remaining();
+      if (timeout_remaining_ms <= 0) {
+        break;
+      }
+      uint32_t timeout = std::min(static_cast<uint32_t> (timeout_remaining_ms),
+                                  timeout_.inter_byte_timeout);
+      if (uring_->waitReadable (timeout, ec)) {
+        bytes_read += uring_->read (buf + bytes_read, size - bytes_read, ec);
+      }
+    }
+    return bytes_read;
+  }
+
   // Pre-fill buffer with available bytes
   {
     ssize_t bytes_read_now = ::read (fd_, buf, size);
@@ -562,12 +773,17 @@ Serial::SerialImpl::read (uint8_t *buf, size_t size)
     uint32_t timeout = std::min(static_cast<uint32_t> (timeout_remaining_ms),
                                 timeout_.inter_byte_timeout);
     // Wait for the device to be readable, and then attempt to read.
-    if (waitReadable(timeout)) {
+    if (waitReadable(timeout, ec)) {
       // If it's a fixed-length multi-byte read, insert a wait here so that
       // we can attempt to grab the whole thing in a single IO call. Skip
-      // this wait if a non-max inter_byte_timeout is specified.
-      if (size > 1 && timeout_.inter_byte_timeout == Timeout::max()) {
-        size_t bytes_available = available();
+      // this wait if a non-max inter_byte_timeout is specified or the low
+      // latency profile is enabled.
+      if (size > 1 && timeout_.inter_byte_timeout == Timeout::max()
+          && !low_latency_) {
+        size_t bytes_available = available(ec);
+        if (ec) {
+          break;
+        }
         if (bytes_available + bytes_read < size) {
           waitByteTimes(size - (bytes_available + bytes_read));
         }
@@ -582,8 +798,8 @@ Serial::SerialImpl::read (uint8_t *buf, size_t size)
         // Disconnected devices, at least on Linux, show the
         // behavior that they are always ready to read immediately
         // but reading returns nothing.
-        throw SerialException ("device reports readiness to read but "
-                               "returned no data (device disconnected?)");
+        ec = std::make_error_code (std::errc::no_such_device);
+        break;
       }
       // Update bytes_read
       bytes_read += static_cast<size_t> (bytes_read_now);
@@ -597,29 +813,66 @@ Serial::SerialImpl::read (uint8_t *buf, size_t size)
       }
       // If bytes_read > size then we have over read, which shouldn't happen
       if (bytes_read > size) {
-        throw SerialException ("read over read, too many bytes where "
-                               "read, this shouldn't happen, might be "
-                               "a logical error!");
+        ec = std::make_error_code (std::errc::value_too_large);
+        break;
       }
     }
+    if (ec) {
+      break;
+    }
   }
   return bytes_read;
 }
 
 size_t
-Serial::SerialImpl::write (const uint8_t *data, size_t length)
+Serial::SerialImpl::read (uint8_t *buf, size_t size)
+{
+  std::error_code ec;
+  size_t bytes_read = read (buf, size, ec);
+  if (ec) {
+    throwError (ec, "Serial::read");
+  }
+  return bytes_read;
+}
+
+size_t
+Serial::SerialImpl::write (const uint8_t *data, size_t length, std::error_code &ec) noexcept
 {
+  ec.clear ();
   if (is_open_ == false) {
-    throw PortNotOpenedException ("Serial::write");
+    ec = std::make_error_code (std::errc::bad_file_descriptor);
+    return 0;
   }
   fd_set writefds;
   size_t bytes_written = 0;
 
-  // Calculate total timeout in milliseconds t_c + (t_m * N)
+  // Calculate total timeout in milliseconds t_c + (t_m * N) + (t_us * N) / 1000
   long total_timeout_ms = timeout_.write_timeout_constant;
   total_timeout_ms += timeout_.write_timeout_multiplier * static_cast<long> (length);
+  total_timeout_ms += static_cast<long> (
+      (static_cast<uint64_t> (timeout_.write_timeout_multiplier_us) * length + 999) / 1000);
   MillisecondTimer total_timeout(total_timeout_ms);
 
+  if (uring_ != NULL) {
+    // Queue behind anything writeAsync left in the ring and wait for it all
+    // to reach the driver; the ring itself cancels a write that outlives the
+    // write timeout.
+    uint64_t base = uring_->bytesWritten () + uring_->writePending ();
+    if (uring_->write (data, length, ec) == 0 && ec) {
+      return 0;
+    }
+    int64_t remaining = total_timeout.remaining ();
+    uring_->waitWritten (remaining > 0 ? static_cast<uint32_t> (remaining) : 0, ec);
+    uint64_t done = uring_->bytesWritten ();
+    return done > base ? std::min<size_t> (length, done - base) : 0;
+  }
+
+  // Bytes queued by writeAsync go out first, so the order on the wire
+  // matches the order of the calls.
+  if (!txWaitEmpty (&total_timeout, ec)) {
+    return 0;
+  }
+
   bool first_iteration = true;
   while (bytes_written < length) {
     int64_t timeout_remaining_ms = total_timeout.remaining();
@@ -647,7 +900,8 @@ Serial::SerialImpl::write (const uint8_t *data, size_t length)
         continue;
       }
       // Otherwise there was some error
-      THROW (IOException, errno);
+      ec.assign (errno, std::system_category ());
+      break;
     }
     /** Timeout **/
     if (r == 0) {
@@ -666,8 +920,8 @@ Serial::SerialImpl::write (const uint8_t *data, size_t length)
           // Disconnected devices, at least on Linux, show the
           // behavior that they are always ready to write immediately
           // but writing returns nothing.
-          throw SerialException ("device reports readiness to write but "
-                                 "returned no data (device disconnected?)");
+          ec = std::make_error_code (std::errc::no_such_device);
+          break;
         }
         // Update bytes_written
         bytes_written += static_cast<size_t> (bytes_written_now);
@@ -681,19 +935,293 @@ Serial::SerialImpl::write (const uint8_t *data, size_t length)
         }
         // If bytes_written > size then we have over written, which shouldn't happen
         if (bytes_written > length) {
-          throw SerialException ("write over wrote, too many bytes where "
-                                 "written, this shouldn't happen, might be "
-                                 "a logical error!");
+          ec = std::make_error_code (std::errc::value_too_large);
+          break;
         }
       }
       // This shouldn't happen, if r > 0 our fd has to be in the list!
-      THROW (IOException, "select reports ready to write, but our fd isn't"
-                          " in the list, this shouldn't happen!");
+      ec = std::make_error_code (std::errc::state_not_recoverable);
+      break;
     }
   }
   return bytes_written;
 }
 
+size_t
+Serial::SerialImpl::write (const uint8_t *data, size_t length)
+{
+  std::error_code ec;
+  size_t bytes_written = write (data, length, ec);
+  if (ec) {
+    throwError (ec, "Serial::write");
+  }
+  return bytes_written;
+}
+
+size_t
+Serial::SerialImpl::writeAsync (const uint8_t *data, size_t length, std::error_code &ec) noexcept
+{
+  ec.clear ();
+  if (is_open_ == false) {
+    ec = std::make_error_code (std::errc::bad_file_descriptor);
+    return 0;
+  }
+  if (uring_ != NULL) {
+    return uring_->write (data, length, ec);
+  }
+
+  pthread_mutex_lock (&tx_mutex_);
+  if (tx_error_) {
+    ec = tx_error_;
+    tx_error_.clear ();
+    pthread_mutex_unlock (&tx_mutex_);
+    return 0;
+  }
+
+  // All or nothing: a partly sent frame would desync the peer's parser.
+  size_t queued = tx_queue_.size () - tx_head_;
+  size_t room = tx_limit_ > queued ? tx_limit_ - queued : 0;
+  if (length > room) {
+    ec = std::make_error_code (std::errc::no_buffer_space);
+    pthread_mutex_unlock (&tx_mutex_);
+    return 0;
+  }
+
+  // Nothing queued: hand as much as fits straight to the kernel TX buffer,
+  // which is all a short frame needs.
+  size_t accepted = 0;
+  if (queued == 0) {
+    ssize_t n = ::write (fd_, data, length);
+    if (n > 0) {
+      accepted = static_cast<size_t> (n);
+    } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+      ec.assign (errno, std::system_category ());
+      pthread_mutex_unlock (&tx_mutex_);
+      return 0;
+    }
+  }
+
+  if (accepted < length) {
+    if (tx_head_ > 0 && tx_head_ == tx_queue_.size ()) {
+      tx_queue_.clear ();
+      tx_head_ = 0;
+    }
+    tx_queue_.insert (tx_queue_.end (), data + accepted, data + length);
+    accepted = length;
+
+    if (!tx_running_) {
+      tx_stop_ = false;
+      if (pthread_create (&tx_thread_, NULL, &SerialImpl::txThread, this) == 0) {
+        tx_running_ = true;
+      } else {
+        ec = std::make_error_code (std::errc::resource_unavailable_try_again);
+      }
+    }
+    pthread_cond_signal (&tx_cond_);
+  }
+  pthread_mutex_unlock (&tx_mutex_);
+  return accepted;
+}
+
+bool
+Serial::SerialImpl::takeWriteError (std::error_code &ec) noexcept
+{
+  ec.clear ();
+  if (uring_ != NULL) {
+    return uring_->takeError (ec);
+  }
+  pthread_mutex_lock (&tx_mutex_);
+  if (tx_error_) {
+    ec = tx_error_;
+    tx_error_.clear ();
+  }
+  pthread_mutex_unlock (&tx_mutex_);
+  return static_cast<bool> (ec);
+}
+
+size_t
+Serial::SerialImpl::writePending () noexcept
+{
+  pthread_mutex_lock (&tx_mutex_);
+  size_t pending = tx_queue_.size () - tx_head_;
+  pthread_mutex_unlock (&tx_mutex_);
+  if (uring_ != NULL) {
+    pending += uring_->writePending ();
+  }
+
+  int outq = 0;
+  if (is_open_ && ioctl (fd_, TIOCOUTQ, &outq) == 0 && outq > 0) {
+    pending += static_cast<size_t> (outq);
+  }
+  return pending;
+}
+
+bool
+Serial::SerialImpl::waitWriteComplete (uint32_t timeout, std::error_code &ec) noexcept
+{
+  ec.clear ();
+  if (is_open_ == false) {
+    ec = std::make_error_code (std::errc::bad_file_descriptor);
+    return false;
+  }
+  MillisecondTimer timer (timeout);
+  if (!txWaitEmpty (&timer, ec)) {
+    return false;
+  }
+
+  // The queue is in the kernel; poll TIOCOUTQ, sleeping about as long as
+  // the remaining bytes take on the wire.
+  while (true) {
+    int outq = 0;
+    if (ioctl (fd_, TIOCOUTQ, &outq) == -1) {
+      // No TIOCOUTQ on this driver, fall back to a blocking drain.
+      tcdrain (fd_);
+      return true;
+    }
+    if (outq == 0) {
+      return true;
+    }
+    int64_t remaining = timer.remaining ();
+    if (remaining <= 0) {
+      return false;
+    }
+    uint64_t wait_ns = static_cast<uint64_t> (byte_time_ns_) * outq;
+    wait_ns = std::max<uint64_t> (wait_ns, 100000);
+    wait_ns = std::min<uint64_t> (wait_ns, remaining * 1000000ULL);
+    timespec ts = { static_cast<time_t> (wait_ns / 1000000000ULL),
+                    static_cast<long> (wait_ns % 1000000000ULL) };
+    nanosleep (&ts, NULL);
+  }
+}
+
+bool
+Serial::SerialImpl::txWaitEmpty (MillisecondTimer *timer, std::error_code &ec) noexcept
+{
+  if (uring_ != NULL) {
+    int64_t remaining = timer->remaining ();
+    return uring_->waitWritten (remaining > 0 ? static_cast<uint32_t> (remaining) : 0, ec);
+  }
+  pthread_mutex_lock (&tx_mutex_);
+  while (tx_head_ < tx_queue_.size () && !tx_error_) {
+    int64_t remaining = timer->remaining ();
+    if (remaining <= 0) {
+      pthread_mutex_unlock (&tx_mutex_);
+      return false;
+    }
+    timespec ts;
+    clock_gettime (CLOCK_REALTIME, &ts);
+    uint64_t ns = static_cast<uint64_t> (ts.tv_nsec) + remaining * 1000000ULL;
+    ts.tv_sec += ns / 1000000000ULL;
+    ts.tv_nsec = ns % 1000000000ULL;
+    pthread_cond_timedwait (&tx_empty_cond_, &tx_mutex_, &ts);
+  }
+  if (tx_error_) {
+    ec = tx_error_;
+    tx_error_.clear ();
+  }
+  pthread_mutex_unlock (&tx_mutex_);
+  return !ec;
+}
+
+void *
+Serial::SerialImpl::txThread (void *arg)
+{
+  static_cast<SerialImpl *> (arg)->txLoop ();
+  return NULL;
+}
+
+void
+Serial::SerialImpl::txLoop ()
+{
+  pthread_mutex_lock (&tx_mutex_);
+  while (!tx_stop_) {
+    if (tx_head_ == tx_queue_.size ()) {
+      pthread_cond_wait (&tx_cond_, &tx_mutex_);
+      continue;
+    }
+
+    // The fd is non-blocking, so writing under the lock never stalls.
+    ssize_t n = ::write (fd_, &tx_queue_[tx_head_], tx_queue_.size () - tx_head_);
+    if (n > 0) {
+      tx_head_ += static_cast<size_t> (n);
+      if (tx_head_ == tx_queue_.size ()) {
+        tx_queue_.clear ();
+        tx_head_ = 0;
+        pthread_cond_broadcast (&tx_empty_cond_);
+      }
+      continue;
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+      if (n == 0) {
+        tx_error_ = std::make_error_code (std::errc::no_such_device);
+      } else {
+        tx_error_.assign (errno, std::system_category ());
+      }
+      tx_queue_.clear ();
+      tx_head_ = 0;
+      pthread_cond_broadcast (&tx_empty_cond_);
+      continue;
+    }
+
+    // Kernel buffer full: wait for room without holding the lock.
+    pthread_mutex_unlock (&tx_mutex_);
+    fd_set writefds;
+    FD_ZERO (&writefds);
+    FD_SET (fd_, &writefds);
+    timespec timeout = timespec_from_ms (20);
+    pselect (fd_ + 1, NULL, &writefds, NULL, &timeout, NULL);
+    pthread_mutex_lock (&tx_mutex_);
+  }
+  pthread_mutex_unlock (&tx_mutex_);
+}
+
+void
+Serial::SerialImpl::txStop ()
+{
+  pthread_mutex_lock (&tx_mutex_);
+  bool running = tx_running_;
+  tx_stop_ = true;
+  pthread_cond_signal (&tx_cond_);
+  pthread_mutex_unlock (&tx_mutex_);
+
+  if (running) {
+    pthread_join (tx_thread_, NULL);
+  }
+
+  pthread_mutex_lock (&tx_mutex_);
+  tx_running_ = false;
+  tx_stop_ = false;
+  tx_queue_.clear ();
+  tx_head_ = 0;
+  tx_error_.clear ();
+  pthread_cond_broadcast (&tx_empty_cond_);
+  pthread_mutex_unlock (&tx_mutex_);
+}
+
+void
+Serial::SerialImpl::throwError (const std::error_code &ec, const char *what)
+{
+  // Errors from the noexcept path carry errno in the system category and
+  // the library's own conditions in the generic category.
+  if (ec.category () == std::system_category ()) {
+    THROW (IOException, ec.value ());
+  }
+  if (ec == std::errc::bad_file_descriptor) {
+    throw PortNotOpenedException (what);
+  }
+  if (ec == std::errc::no_such_device) {
+    std::string msg = std::string ("device reports readiness but ") + what
+                      + " returned no data (device disconnected?)";
+    throw SerialException (msg.c_str ());
+  }
+  if (ec == std::errc::state_not_recoverable) {
+    THROW (IOException, "select reports ready, but our fd isn't"
+                        " in the list, this shouldn't happen!");
+  }
+  std::string msg = std::string (what) + ": " + ec.message ();
+  throw SerialException (msg.c_str ());
+}
+
 void
 Serial::SerialImpl::setPort (const string &port)
 {
@@ -710,6 +1238,7 @@ void
 Serial::SerialImpl::setTimeout (serial::Timeout &timeout)
 {
   timeout_ = timeout;
+  applyWriteTimeout ();
 }
 
 serial::Timeout
@@ -788,6 +1317,58 @@ Serial::SerialImpl::getFlowcontrol () const
   return flowcontrol_;
 }
 
+void
+Serial::SerialImpl::setLowLatency (bool enabled)
+{
+  low_latency_ = enabled;
+  if (is_open_)
+    reconfigurePort ();
+}
+
+bool
+Serial::SerialImpl::getLowLatency () const
+{
+  return low_latency_;
+}
+
+bool
+Serial::SerialImpl::setIoUring (bool enabled)
+{
+  use_uring_ = enabled;
+  if (!is_open_) {
+    return false;
+  }
+  std::error_code ec;
+  if (enabled && uring_ == NULL) {
+    // Let the select path's write queue drain before the ring takes over.
+    MillisecondTimer timer (1000);
+    txWaitEmpty (&timer, ec);
+    uring_ = UringChannel::open (fd_);
+    applyWriteTimeout ();
+  } else if (!enabled && uring_ != NULL) {
+    uring_->waitWritten (1000, ec);
+    delete uring_;
+    uring_ = NULL;
+  }
+  return uring_ != NULL;
+}
+
+bool
+Serial::SerialImpl::getIoUring () const
+{
+  return uring_ != NULL;
+}
+
+void
+Serial::SerialImpl::applyWriteTimeout ()
+{
+  if (uring_ != NULL) {
+    uring_->setWriteTimeout (timeout_.write_timeout_constant,
+                             timeout_.write_timeout_multiplier * 1000
+                             + timeout_.write_timeout_multiplier_us);
+  }
+}
+
 void
 Serial::SerialImpl::flush ()
 {
@@ -804,6 +1385,9 @@ Serial::SerialImpl::flushInput ()
     throw PortNotOpenedException ("Serial::flushInput");
   }
   tcflush (fd_, TCIFLUSH);
+  if (uring_ != NULL) {
+    uring_->flushInput ();
+  }
 }
 
 void
@@ -933,7 +1517,7 @@ while (is_open_ == true) {
 #else
   int command = (TIOCM_CD|TIOCM_DSR|TIOCM_RI|TIOCM_CTS);
 
-  if (-1 == ioctl (fd_, TIOCMIWAIT, &command)) {
+  if (-1 == ioctl (fd_, TIOCMIWAIT, command)) {
     stringstream ss;
     ss << "waitForDSR failed on a call to ioctl(TIOCMIWAIT): "
        << errno << " " << strerror(errno);
@@ -943,6 +1527,152 @@ while (is_open_ == true) {
 #endif
 }
 
+bool
+Serial::SerialImpl::startModemMonitor (const ModemCallback &callback)
+{
+  int status;
+  if (is_open_ == false || modem_running_ || !callback
+      || ioctl (fd_, TIOCMGET, &status) == -1) {
+    return false;
+  }
+
+  // Without a handler the wakeup signal would kill the process, and with
+  // SIG_IGN it would not interrupt the ioctl. Leave an existing handler be.
+  struct sigaction old_action;
+  if (sigaction (SERIAL_MODEM_WAKEUP_SIGNAL, NULL, &old_action) == 0
+      && old_action.sa_handler == SIG_DFL) {
+    struct sigaction action;
+    memset (&action, 0, sizeof (action));
+    action.sa_handler = modem_wakeup_handler;
+    sigemptyset (&action.sa_mask);
+    action.sa_flags = 0;      // no SA_RESTART, TIOCMIWAIT must return EINTR
+    sigaction (SERIAL_MODEM_WAKEUP_SIGNAL, &action, NULL);
+  }
+
+  modem_stop_ = false;
+  modem_exited_ = false;
+  modem_callback_ = callback;
+  if (pthread_create (&modem_thread_, NULL, &SerialImpl::modemThread, this) != 0) {
+    modem_callback_ = ModemCallback ();
+    return false;
+  }
+  modem_running_ = true;
+  return true;
+}
+
+void
+Serial::SerialImpl::stopModemMonitor ()
+{
+  if (!modem_running_) {
+    return;
+  }
+  modem_stop_ = true;
+  // The signal can land just before the thread enters TIOCMIWAIT, so keep
+  // sending it until the thread is out.
+  while (!modem_exited_) {
+    pthread_kill (modem_thread_, SERIAL_MODEM_WAKEUP_SIGNAL);
+    usleep (1000);
+  }
+  pthread_join (modem_thread_, NULL);
+  modem_running_ = false;
+  modem_callback_ = ModemCallback ();
+}
+
+void *
+Serial::SerialImpl::modemThread (void *arg)
+{
+  static_cast<SerialImpl *> (arg)->modemLoop ();
+  return NULL;
+}
+
+void
+Serial::SerialImpl::modemLoop ()
+{
+  // The thread inherits the creator's mask, which may block the signal.
+  sigset_t wakeup;
+  sigemptyset (&wakeup);
+  sigaddset (&wakeup, SERIAL_MODEM_WAKEUP_SIGNAL);
+  pthread_sigmask (SIG_UNBLOCK, &wakeup, NULL);
+
+  int status = 0;
+  ioctl (fd_, TIOCMGET, &status);
+  ModemEvent event;
+  event.lines = modem_lines (status);
+  event.changed = 0;
+  event.timestamp_us = monotonic_us ();
+  modem_callback_ (event);
+
+#if defined(__linux__) && defined(TIOCGICOUNT)
+  struct serial_icounter_struct counters;
+  bool have_counters = ioctl (fd_, TIOCGICOUNT, &counters) == 0;
+#endif
+#ifdef TIOCMIWAIT
+  bool use_wait = true;
+#else
+  bool use_wait = false;
+#endif
+
+  while (!modem_stop_) {
+    if (use_wait) {
+#ifdef TIOCMIWAIT
+      // The mask is passed by value.
+      if (-1 == ioctl (fd_, TIOCMIWAIT, TIOCM_CTS | TIOCM_DSR | TIOCM_RNG | TIOCM_CD)) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno != EIO) {
+          // Driver without TIOCMIWAIT support.
+          use_wait = false;
+          continue;
+        }
+      }
+#endif
+    } else {
+      timespec wait_time = timespec_from_ms (10);
+      nanosleep (&wait_time, NULL);
+      if (modem_stop_) {
+        break;
+      }
+    }
+
+    if (-1 == ioctl (fd_, TIOCMGET, &status)) {
+      if (errno == EIO || errno == ENXIO || errno == ENODEV) {
+        // Hung up: the lines are gone along with the device.
+        event.changed = event.lines;
+        event.lines = 0;
+        event.timestamp_us = monotonic_us ();
+        if (event.changed != 0) {
+          modem_callback_ (event);
+        }
+        break;
+      }
+      continue;
+    }
+
+    uint32_t lines = modem_lines (status);
+    uint32_t changed = lines ^ event.lines;
+#if defined(__linux__) && defined(TIOCGICOUNT)
+    struct serial_icounter_struct now;
+    if (have_counters && ioctl (fd_, TIOCGICOUNT, &now) == 0) {
+      if (now.cts != counters.cts) changed |= modem_cts;
+      if (now.dsr != counters.dsr) changed |= modem_dsr;
+      if (now.rng != counters.rng) changed |= modem_ri;
+      if (now.dcd != counters.dcd) changed |= modem_cd;
+      counters = now;
+    }
+#endif
+    if (changed == 0) {
+      continue;
+    }
+    event.lines = lines;
+    event.changed = changed;
+    event.timestamp_us = monotonic_us ();
+    modem_callback_ (event);
+  }
+
+  modem_exited_ = true;
+}
+
 bool
 Serial::SerialImpl::getCTS ()
 {
@@ -1027,6 +1757,12 @@ Serial::SerialImpl::getCD ()
   }
 }
 
+int
+Serial::SerialImpl::getFd () const
+{
+  return is_open_ ? fd_ : -1;
+}
+
 void
 Serial::SerialImpl::readLock ()
 {
@@ -1063,4 +1799,44 @@ Serial::SerialImpl::writeUnlock ()
   }
 }
 
+bool
+Serial::SerialImpl::readLock (std::error_code &ec) noexcept
+{
+  int result = pthread_mutex_lock(&this->read_mutex);
+  if (result) {
+    ec.assign (result, std::system_category ());
+    return false;
+  }
+  return true;
+}
+
+void
+Serial::SerialImpl::readUnlock (std::error_code &ec) noexcept
+{
+  int result = pthread_mutex_unlock(&this->read_mutex);
+  if (result && !ec) {
+    ec.assign (result, std::system_category ());
+  }
+}
+
+bool
+Serial::SerialImpl::writeLock (std::error_code &ec) noexcept
+{
+  int result = pthread_mutex_lock(&this->write_mutex);
+  if (result) {
+    ec.assign (result, std::system_category ());
+    return false;
+  }
+  return true;
+}
+
+void
+Serial::SerialImpl::writeUnlock (std::error_code &ec) noexcept
+{
+  int result = pthread_mutex_unlock(&this->write_mutex);
+  if (result && !ec) {
+    ec.assign (result, std::system_category ());
+  }
+}
+
 #endif // !defined(_WIN32)
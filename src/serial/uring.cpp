@@ -0,0 +1,908 @@
+#if !defined(_WIN32)
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "serial/impl/uring.h"
+
+#if defined(__linux__) && defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+// IORING_FEAT_EXT_ARG, needed for a timed wait without a timeout request,
+// arrived with the 5.11 headers, which also carry every operation used here.
+#  if defined(IORING_FEAT_EXT_ARG) && defined(__NR_io_uring_setup)
+#   define SERIAL_HAVE_IO_URING 1
+#  endif
+# endif
+#endif
+
+using serial::UringChannel;
+using serial::UringRing;
+
+#if defined(SERIAL_HAVE_IO_URING)
+
+namespace {
+
+// Request kinds, kept in the low bits of user_data next to the channel
+// pointer.
+enum {
+  URING_OP_READ = 1,
+  URING_OP_READ_POLL,
+  URING_OP_WRITE,
+  URING_OP_WRITE_POLL,
+  URING_OP_TIMEOUT,
+  URING_OP_CANCEL,
+  URING_OP_MASK = 7
+};
+
+// Received bytes are buffered up to this much before the read is left
+// unposted, leaving further input in the driver until the reader catches up.
+const size_t uring_rx_limit = 65536;
+const size_t uring_tx_limit = 65536;
+
+timespec
+uring_deadline (uint32_t timeout_ms)
+{
+  timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  uint64_t ns = static_cast<uint64_t> (ts.tv_nsec) + timeout_ms * 1000000ULL;
+  ts.tv_sec += ns / 1000000000ULL;
+  ts.tv_nsec = ns % 1000000000ULL;
+  return ts;
+}
+
+} // namespace
+
+namespace serial {
+
+/*!
+ * The process-wide ring: one submission queue guarded by a mutex and the
+ * registered receive buffer split into one slot per channel. There is no
+ * completion thread; threads waiting on a channel take turns in
+ * io_uring_enter, and the one in there dispatches the completions of every
+ * channel. Created by the first channel and torn down with the last.
+ */
+class UringRing {
+public:
+  static const unsigned entries = 256;
+  static const int slots = 16;
+  static const size_t slot_size = 4096;
+
+  static UringRing *acquire ();
+  void release ();
+
+  int claimSlot ();
+  void freeSlot (int slot);
+  uint8_t *slot (int slot) { return rx_buffer_ + slot * slot_size; }
+  bool fixedBuffers () const { return fixed_; }
+
+  /*! Copies count prepared SQEs into the queue back to back, so that
+   *  linked requests stay together, and submits them. Returns how many the
+   *  kernel took; the rest are withdrawn and will never complete. */
+  unsigned submit (const io_uring_sqe *sqes, unsigned count);
+
+  /*! Bumped each time completions are dispatched. Read it before checking
+   *  a channel's state and pass it to wait(), so that a completion landing
+   *  in between is not missed. */
+  unsigned generation ();
+
+  /*! Waits until completions newer than generation have been dispatched,
+   *  reaping them itself unless another thread already is. Returns false
+   *  once deadline (CLOCK_MONOTONIC) passes with nothing dispatched. */
+  bool wait (unsigned generation, const timespec &deadline);
+
+  /*! Dispatches completions already posted, without a system call. */
+  void poll ();
+
+private:
+  UringRing ();
+  ~UringRing ();
+  bool setup ();
+  bool beginReap ();
+  void endReap (unsigned dispatched);
+  unsigned dispatch ();
+  int enter (unsigned to_submit, unsigned min_complete, unsigned flags,
+             const void *arg, size_t arg_size);
+
+  static pthread_mutex_t instance_mutex_;
+  static UringRing *instance_;
+  int refs_;
+
+  int ring_fd_;
+  void *sq_ptr_;
+  size_t sq_size_;
+  void *cq_ptr_;
+  size_t cq_size_;
+  io_uring_sqe *sqes_;
+  unsigned *sq_head_;
+  unsigned *sq_tail_;
+  unsigned *sq_mask_;
+  unsigned *sq_array_;
+  unsigned sq_entries_;
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned *cq_mask_;
+  io_uring_cqe *cqes_;
+
+  pthread_mutex_t sq_mutex_;
+
+  pthread_mutex_t wait_mutex_;
+  pthread_cond_t reap_cond_;    // a reaping thread finished a batch
+  bool reaping_;                // a thread is dispatching completions
+  unsigned reap_gen_;
+
+  uint8_t *rx_buffer_;
+  bool fixed_;
+  bool slot_used_[slots];
+};
+
+pthread_mutex_t UringRing::instance_mutex_ = PTHREAD_MUTEX_INITIALIZER;
+UringRing *UringRing::instance_ = NULL;
+
+UringRing::UringRing ()
+  : refs_ (0), ring_fd_ (-1), sq_ptr_ (MAP_FAILED), sq_size_ (0),
+    cq_ptr_ (MAP_FAILED), cq_size_ (0), sqes_ (NULL), reaping_ (false),
+    reap_gen_ (0), rx_buffer_ (NULL), fixed_ (false)
+{
+  pthread_mutex_init (&sq_mutex_, NULL);
+  pthread_mutex_init (&wait_mutex_, NULL);
+  pthread_condattr_t attr;
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&reap_cond_, &attr);
+  pthread_condattr_destroy (&attr);
+  memset (slot_used_, 0, sizeof (slot_used_));
+}
+
+UringRing::~UringRing ()
+{
+  if (sqes_ != NULL) {
+    munmap (sqes_, sq_entries_ * sizeof (io_uring_sqe));
+  }
+  if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) {
+    munmap (cq_ptr_, cq_size_);
+  }
+  if (sq_ptr_ != MAP_FAILED) {
+    munmap (sq_ptr_, sq_size_);
+  }
+  if (ring_fd_ != -1) {
+    ::close (ring_fd_);
+  }
+  free (rx_buffer_);
+  pthread_cond_destroy (&reap_cond_);
+  pthread_mutex_destroy (&wait_mutex_);
+  pthread_mutex_destroy (&sq_mutex_);
+}
+
+UringRing *
+UringRing::acquire ()
+{
+  pthread_mutex_lock (&instance_mutex_);
+  if (instance_ == NULL) {
+    UringRing *ring = new UringRing ();
+    if (ring->setup ()) {
+      instance_ = ring;
+    } else {
+      delete ring;
+    }
+  }
+  UringRing *ring = instance_;
+  if (ring != NULL) {
+    ring->refs_++;
+  }
+  pthread_mutex_unlock (&instance_mutex_);
+  return ring;
+}
+
+void
+UringRing::release ()
+{
+  pthread_mutex_lock (&instance_mutex_);
+  if (--refs_ == 0) {
+    instance_ = NULL;
+    delete this;
+  }
+  pthread_mutex_unlock (&instance_mutex_);
+}
+
+bool
+UringRing::setup ()
+{
+  io_uring_params params;
+  memset (&params, 0, sizeof (params));
+  ring_fd_ = static_cast<int> (syscall (__NR_io_uring_setup, entries, &params));
+  if (ring_fd_ < 0) {
+    // ENOSYS on old kernels, EPERM when disabled by sysctl or seccomp.
+    ring_fd_ = -1;
+    return false;
+  }
+
+  // Every operation used must be known to the running kernel.
+  size_t probe_size = sizeof (io_uring_probe) + 256 * sizeof (io_uring_probe_op);
+  io_uring_probe *probe = static_cast<io_uring_probe *> (calloc (1, probe_size));
+  bool supported = probe != NULL
+    && syscall (__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe, 256) == 0;
+  const int needed[] = { IORING_OP_NOP, IORING_OP_READ, IORING_OP_READ_FIXED,
+                         IORING_OP_WRITE, IORING_OP_POLL_ADD,
+                         IORING_OP_LINK_TIMEOUT, IORING_OP_ASYNC_CANCEL };
+  for (size_t i = 0; supported && i < sizeof (needed) / sizeof (needed[0]); i++) {
+    supported = needed[i] <= probe->last_op
+      && (probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED);
+  }
+  free (probe);
+  if (!supported || !(params.features & IORING_FEAT_EXT_ARG)) {
+    return false;
+  }
+
+  sq_entries_ = params.sq_entries;
+  sq_size_ = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+  cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof (io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sq_size_ = cq_size_ = std::max (sq_size_, cq_size_);
+  }
+  sq_ptr_ = mmap (NULL, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ring_fd_, IORING_OFF_SQ_RING);
+  if (sq_ptr_ == MAP_FAILED) {
+    return false;
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    cq_ptr_ = sq_ptr_;
+  } else {
+    cq_ptr_ = mmap (NULL, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring_fd_, IORING_OFF_CQ_RING);
+    if (cq_ptr_ == MAP_FAILED) {
+      return false;
+    }
+  }
+  void *sqes = mmap (NULL, sq_entries_ * sizeof (io_uring_sqe), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return false;
+  }
+  sqes_ = static_cast<io_uring_sqe *> (sqes);
+
+  uint8_t *sq = static_cast<uint8_t *> (sq_ptr_);
+  uint8_t *cq = static_cast<uint8_t *> (cq_ptr_);
+  sq_head_ = reinterpret_cast<unsigned *> (sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned *> (sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned *> (sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned *> (sq + params.sq_off.array);
+  cq_head_ = reinterpret_cast<unsigned *> (cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *> (cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned *> (cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe *> (cq + params.cq_off.cqes);
+
+  // Receive slots. Registering them saves the per-read page pinning; if
+  // that fails (RLIMIT_MEMLOCK on older kernels) plain reads are used.
+  void *buffer = NULL;
+  if (posix_memalign (&buffer, 4096, slots * slot_size) != 0) {
+    return false;
+  }
+  rx_buffer_ = static_cast<uint8_t *> (buffer);
+  iovec iov[slots];
+  for (int i = 0; i < slots; i++) {
+    iov[i].iov_base = slot (i);
+    iov[i].iov_len = slot_size;
+  }
+  fixed_ = syscall (__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS, iov, slots) == 0;
+  return true;
+}
+
+int
+UringRing::claimSlot ()
+{
+  pthread_mutex_lock (&instance_mutex_);
+  int found = -1;
+  for (int i = 0; i < slots && found < 0; i++) {
+    if (!slot_used_[i]) {
+      slot_used_[i] = true;
+      found = i;
+    }
+  }
+  pthread_mutex_unlock (&instance_mutex_);
+  return found;
+}
+
+void
+UringRing::freeSlot (int slot)
+{
+  pthread_mutex_lock (&instance_mutex_);
+  slot_used_[slot] = false;
+  pthread_mutex_unlock (&instance_mutex_);
+}
+
+int
+UringRing::enter (unsigned to_submit, unsigned min_complete, unsigned flags,
+                  const void *arg, size_t arg_size)
+{
+  return static_cast<int> (syscall (__NR_io_uring_enter, ring_fd_, to_submit,
+                                    min_complete, flags, arg, arg_size));
+}
+
+unsigned
+UringRing::submit (const io_uring_sqe *sqes, unsigned count)
+{
+  pthread_mutex_lock (&sq_mutex_);
+  // Without SQPOLL the kernel only consumes the queue inside io_uring_enter,
+  // and every submit leaves it empty, so the entries always fit.
+  unsigned tail = *sq_tail_;
+  if (count > sq_entries_) {
+    pthread_mutex_unlock (&sq_mutex_);
+    return 0;
+  }
+  for (unsigned i = 0; i < count; i++) {
+    unsigned index = (tail + i) & *sq_mask_;
+    sqes_[index] = sqes[i];
+    sq_array_[index] = index;
+  }
+  __atomic_store_n (sq_tail_, tail + count, __ATOMIC_RELEASE);
+
+  unsigned taken = 0;
+  while (taken < count) {
+    int r = enter (count - taken, 0, 0, NULL, 0);
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    taken = __atomic_load_n (sq_head_, __ATOMIC_ACQUIRE) - tail;
+    if (r <= 0) {
+      break;
+    }
+  }
+  // Entries left behind (EAGAIN, EBUSY) are withdrawn: the caller treats
+  // them as never sent, so a later enter must not pick them up.
+  if (taken < count) {
+    __atomic_store_n (sq_tail_, tail + taken, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock (&sq_mutex_);
+  return taken;
+}
+
+unsigned
+UringRing::generation ()
+{
+  return __atomic_load_n (&reap_gen_, __ATOMIC_ACQUIRE);
+}
+
+bool
+UringRing::wait (unsigned generation, const timespec &deadline)
+{
+  pthread_mutex_lock (&wait_mutex_);
+  // Whoever is reaping dispatches this caller's completions too; wait for
+  // it to finish a batch rather than entering the kernel a second time.
+  while (reaping_ && reap_gen_ == generation) {
+    if (pthread_cond_timedwait (&reap_cond_, &wait_mutex_, &deadline) != 0) {
+      pthread_mutex_unlock (&wait_mutex_);
+      return false;
+    }
+  }
+  if (reap_gen_ != generation) {
+    pthread_mutex_unlock (&wait_mutex_);
+    return true;
+  }
+  reaping_ = true;
+  pthread_mutex_unlock (&wait_mutex_);
+
+  timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  int64_t ns = static_cast<int64_t> (deadline.tv_sec - now.tv_sec) * 1000000000LL
+    + (deadline.tv_nsec - now.tv_nsec);
+  bool expired = ns <= 0;
+  if (!expired && *cq_head_ == __atomic_load_n (cq_tail_, __ATOMIC_ACQUIRE)) {
+    __kernel_timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    io_uring_getevents_arg arg;
+    memset (&arg, 0, sizeof (arg));
+    arg.ts = reinterpret_cast<uintptr_t> (&ts);
+    if (enter (0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof (arg)) < 0
+        && errno == ETIME) {
+      expired = true;
+    }
+  }
+  unsigned dispatched = dispatch ();
+  endReap (dispatched);
+  return dispatched > 0 || !expired;
+}
+
+void
+UringRing::poll ()
+{
+  if (__atomic_load_n (cq_head_, __ATOMIC_RELAXED)
+      == __atomic_load_n (cq_tail_, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  // A thread already reaping picks these up itself.
+  if (beginReap ()) {
+    endReap (dispatch ());
+  }
+}
+
+bool
+UringRing::beginReap ()
+{
+  pthread_mutex_lock (&wait_mutex_);
+  bool taken = !reaping_;
+  reaping_ = true;
+  pthread_mutex_unlock (&wait_mutex_);
+  return taken;
+}
+
+void
+UringRing::endReap (unsigned dispatched)
+{
+  pthread_mutex_lock (&wait_mutex_);
+  reaping_ = false;
+  if (dispatched > 0) {
+    __atomic_store_n (&reap_gen_, reap_gen_ + 1, __ATOMIC_RELEASE);
+  }
+  // Also wakes a waiter to take over reaping.
+  pthread_cond_broadcast (&reap_cond_);
+  pthread_mutex_unlock (&wait_mutex_);
+}
+
+unsigned
+UringRing::dispatch ()
+{
+  // Only the reaping thread gets here, so the head is ours to move.
+  unsigned dispatched = 0;
+  unsigned head = *cq_head_;
+  unsigned tail = __atomic_load_n (cq_tail_, __ATOMIC_ACQUIRE);
+  while (head != tail) {
+    const io_uring_cqe &cqe = cqes_[head & *cq_mask_];
+    uint64_t user_data = cqe.user_data;
+    int res = cqe.res;
+    head++;
+    __atomic_store_n (cq_head_, head, __ATOMIC_RELEASE);
+
+    UringChannel *channel = reinterpret_cast<UringChannel *> (
+      static_cast<uintptr_t> (user_data & ~static_cast<uint64_t> (URING_OP_MASK)));
+    channel->onComplete (static_cast<unsigned> (user_data & URING_OP_MASK), res);
+    dispatched++;
+    if (head == tail) {
+      tail = __atomic_load_n (cq_tail_, __ATOMIC_ACQUIRE);
+    }
+  }
+  return dispatched;
+}
+
+} // namespace serial
+
+static uint64_t
+uring_tag (UringChannel *channel, unsigned op)
+{
+  return static_cast<uint64_t> (reinterpret_cast<uintptr_t> (channel)) | op;
+}
+
+UringChannel *
+UringChannel::open (int fd)
+{
+  UringRing *ring = UringRing::acquire ();
+  if (ring == NULL) {
+    return NULL;
+  }
+  int slot = ring->claimSlot ();
+  if (slot < 0) {
+    ring->release ();
+    return NULL;
+  }
+  UringChannel *channel = new UringChannel (ring, fd, slot);
+  pthread_mutex_lock (&channel->mutex_);
+  channel->postRead ();
+  pthread_mutex_unlock (&channel->mutex_);
+  return channel;
+}
+
+UringChannel::UringChannel (UringRing *ring, int fd, int slot)
+  : ring_ (ring), fd_ (fd), slot_ (slot), inflight_ (0), closing_ (false),
+    rx_head_ (0), read_posted_ (false), poll_failures_ (0), tx_offset_ (0), write_posted_ (false),
+    tx_written_ (0), write_constant_ms_ (1000), write_per_byte_us_ (0)
+{
+  pthread_mutex_init (&mutex_, NULL);
+  write_timeout_.tv_sec = 0;
+  write_timeout_.tv_nsec = 0;
+}
+
+UringChannel::~UringChannel ()
+{
+  pthread_mutex_lock (&mutex_);
+  closing_ = true;
+  const unsigned posted[] = { URING_OP_READ, URING_OP_READ_POLL,
+                              URING_OP_WRITE, URING_OP_WRITE_POLL };
+  // A poll whose linked request never went in is still pending, so every
+  // kind is cancelled while anything is in flight; cancelling a request
+  // that is gone just completes with ENOENT.
+  for (size_t i = 0; inflight_ > 0 && i < sizeof (posted) / sizeof (posted[0]); i++) {
+    io_uring_sqe sqe;
+    memset (&sqe, 0, sizeof (sqe));
+    sqe.opcode = IORING_OP_ASYNC_CANCEL;
+    sqe.fd = -1;
+    sqe.addr = uring_tag (this, posted[i]);
+    sqe.user_data = uring_tag (this, URING_OP_CANCEL);
+    inflight_ += ring_->submit (&sqe, 1);
+  }
+  pthread_mutex_unlock (&mutex_);
+
+  // Reap until the last completion for this channel is in.
+  for (;;) {
+    unsigned generation = ring_->generation ();
+    pthread_mutex_lock (&mutex_);
+    bool idle = inflight_ == 0;
+    pthread_mutex_unlock (&mutex_);
+    if (idle) {
+      break;
+    }
+    ring_->wait (generation, uring_deadline (100));
+  }
+
+  ring_->freeSlot (slot_);
+  ring_->release ();
+  pthread_mutex_destroy (&mutex_);
+}
+
+void
+UringChannel::postRead ()
+{
+  // Called with mutex_ held. The port runs with VMIN = 0, so a tty read
+  // returns 0 at once instead of waiting; the read is linked behind a
+  // POLLIN poll, which also makes a 0 from it mean the line hung up.
+  io_uring_sqe sqe[2];
+  memset (sqe, 0, sizeof (sqe));
+  unsigned count = 0;
+  sqe[count].opcode = IORING_OP_POLL_ADD;
+  sqe[count].fd = fd_;
+  sqe[count].poll_events = POLLIN;
+  sqe[count].flags = IOSQE_IO_LINK;
+  sqe[count].user_data = uring_tag (this, URING_OP_READ_POLL);
+  count++;
+  sqe[count].opcode = ring_->fixedBuffers () ? IORING_OP_READ_FIXED : IORING_OP_READ;
+  sqe[count].fd = fd_;
+  sqe[count].addr = reinterpret_cast<uintptr_t> (ring_->slot (slot_));
+  sqe[count].len = UringRing::slot_size;
+  sqe[count].buf_index = static_cast<uint16_t> (slot_);
+  sqe[count].user_data = uring_tag (this, URING_OP_READ);
+  count++;
+
+  unsigned submitted = ring_->submit (sqe, count);
+  inflight_ += submitted;
+  if (submitted == count) {
+    read_posted_ = true;
+  } else {
+    // A lone poll that went in is cancelled on close like any other.
+    rx_error_ = std::make_error_code (std::errc::io_error);
+  }
+}
+
+void
+UringChannel::postWrite (bool poll_first)
+{
+  // Called with mutex_ held. Everything queued behind the previous batch
+  // goes out as the next one.
+  if (tx_offset_ == tx_batch_.size ()) {
+    tx_batch_.clear ();
+    tx_offset_ = 0;
+    tx_batch_.swap (tx_pending_);
+  }
+  if (tx_batch_.empty ()) {
+    return;
+  }
+
+  size_t length = tx_batch_.size () - tx_offset_;
+  uint64_t timeout_ms = write_constant_ms_
+    + (static_cast<uint64_t> (write_per_byte_us_) * length + 999) / 1000;
+  // The kernel reads the timespec while preparing the request; keep it in
+  // the channel rather than on this stack frame.
+  write_timeout_.tv_sec = static_cast<int64_t> (timeout_ms / 1000);
+  write_timeout_.tv_nsec = static_cast<int64_t> (timeout_ms % 1000) * 1000000;
+
+  io_uring_sqe sqe[3];
+  memset (sqe, 0, sizeof (sqe));
+  unsigned count = 0;
+  if (poll_first) {
+    sqe[count].opcode = IORING_OP_POLL_ADD;
+    sqe[count].fd = fd_;
+    sqe[count].poll_events = POLLOUT;
+    sqe[count].flags = IOSQE_IO_LINK;
+    sqe[count].user_data = uring_tag (this, URING_OP_WRITE_POLL);
+    count++;
+  }
+  sqe[count].opcode = IORING_OP_WRITE;
+  sqe[count].fd = fd_;
+  sqe[count].addr = reinterpret_cast<uintptr_t> (&tx_batch_[tx_offset_]);
+  sqe[count].len = static_cast<uint32_t> (length);
+  sqe[count].user_data = uring_tag (this, URING_OP_WRITE);
+  count++;
+  // A zero write timeout means no limit, as with the select path's first
+  // attempt.
+  unsigned write_index = count - 1;
+  if (timeout_ms > 0) {
+    sqe[count - 1].flags = IOSQE_IO_LINK;
+    sqe[count].opcode = IORING_OP_LINK_TIMEOUT;
+    sqe[count].fd = -1;
+    sqe[count].addr = reinterpret_cast<uintptr_t> (&write_timeout_);
+    sqe[count].len = 1;
+    sqe[count].user_data = uring_tag (this, URING_OP_TIMEOUT);
+    count++;
+  }
+
+  unsigned submitted = ring_->submit (sqe, count);
+  inflight_ += submitted;
+  if (submitted > write_index) {
+    // Posted, if need be without its timeout; the kernel owns the batch
+    // until the write completes.
+    write_posted_ = true;
+  } else {
+    failWrite (std::make_error_code (std::errc::io_error));
+  }
+}
+
+void
+UringChannel::failWrite (const std::error_code &ec)
+{
+  tx_error_ = ec;
+  tx_batch_.clear ();
+  tx_offset_ = 0;
+  tx_pending_.clear ();
+}
+
+void
+UringChannel::onComplete (unsigned op, int res)
+{
+  pthread_mutex_lock (&mutex_);
+  switch (op) {
+  case URING_OP_READ:
+    read_posted_ = false;
+    if (res > 0) {
+      if (rx_head_ == rx_.size ()) {
+        rx_.clear ();
+        rx_head_ = 0;
+      }
+      const uint8_t *data = ring_->slot (slot_);
+      rx_.insert (rx_.end (), data, data + res);
+    } else if (res == 0) {
+      // A tty reads 0 after a hangup.
+      rx_error_ = std::make_error_code (std::errc::no_such_device);
+    } else if (res != -EAGAIN && res != -ECANCELED && res != -EINTR) {
+      rx_error_.assign (-res, std::system_category ());
+    }
+    if (!closing_ && !rx_error_ && rx_.size () - rx_head_ < uring_rx_limit) {
+      postRead ();
+    }
+    break;
+  case URING_OP_READ_POLL:
+    // A failed poll cancels the read linked to it, which is then posted
+    // again. tcsetattr on the port fails a pending poll with EINVAL, so
+    // only a poll that keeps failing is reported.
+    if (res >= 0) {
+      poll_failures_ = 0;
+    } else if (res != -ECANCELED && res != -EINTR && ++poll_failures_ >= 3) {
+      rx_error_.assign (-res, std::system_category ());
+    }
+    break;
+  case URING_OP_WRITE:
+    write_posted_ = false;
+    if (res > 0) {
+      tx_offset_ += static_cast<size_t> (res);
+      tx_written_ += static_cast<uint64_t> (res);
+      if (!closing_) {
+        postWrite (false);
+      }
+    } else if (res == -EAGAIN) {
+      if (!closing_) {
+        postWrite (true);
+      }
+    } else if (res == -ECANCELED) {
+      // The linked timeout fired: the line is not draining (flow control
+      // held off, or the device is gone).
+      failWrite (std::make_error_code (std::errc::timed_out));
+    } else {
+      failWrite (std::error_code (res == 0 ? EIO : -res, std::system_category ()));
+    }
+    break;
+  default:
+    // Write polls, timeouts and cancels only matter through the request they
+    // are linked to.
+    break;
+  }
+  inflight_--;
+  pthread_mutex_unlock (&mutex_);
+}
+
+size_t
+UringChannel::available (std::error_code &ec)
+{
+  ring_->poll ();
+  pthread_mutex_lock (&mutex_);
+  size_t count = rx_.size () - rx_head_;
+  if (count == 0 && rx_error_) {
+    ec = rx_error_;
+  }
+  pthread_mutex_unlock (&mutex_);
+  return count;
+}
+
+size_t
+UringChannel::read (uint8_t *buf, size_t size, std::error_code &ec)
+{
+  ring_->poll ();
+  pthread_mutex_lock (&mutex_);
+  size_t count = std::min (size, rx_.size () - rx_head_);
+  if (count > 0) {
+    memcpy (buf, &rx_[rx_head_], count);
+    rx_head_ += count;
+  } else if (rx_error_) {
+    ec = rx_error_;
+  }
+  // The read is left unposted while the buffer is over the limit.
+  if (!read_posted_ && !closing_ && !rx_error_ && rx_.size () - rx_head_ < uring_rx_limit) {
+    postRead ();
+  }
+  pthread_mutex_unlock (&mutex_);
+  return count;
+}
+
+bool
+UringChannel::waitReadable (uint32_t timeout_ms, std::error_code &ec)
+{
+  // The waiting thread reaps the ring itself, so arriving data wakes it
+  // directly instead of going through a completion thread.
+  timespec deadline = uring_deadline (timeout_ms);
+  for (;;) {
+    unsigned generation = ring_->generation ();
+    pthread_mutex_lock (&mutex_);
+    bool waiting = rx_head_ == rx_.size () && !rx_error_;
+    pthread_mutex_unlock (&mutex_);
+    if (!waiting || !ring_->wait (generation, deadline)) {
+      break;
+    }
+  }
+  pthread_mutex_lock (&mutex_);
+  bool readable = rx_head_ < rx_.size ();
+  if (!readable && rx_error_) {
+    ec = rx_error_;
+  }
+  pthread_mutex_unlock (&mutex_);
+  return readable;
+}
+
+void
+UringChannel::flushInput ()
+{
+  pthread_mutex_lock (&mutex_);
+  rx_.clear ();
+  rx_head_ = 0;
+  if (!read_posted_ && !closing_ && !rx_error_) {
+    postRead ();
+  }
+  pthread_mutex_unlock (&mutex_);
+}
+
+void
+UringChannel::setWriteTimeout (uint32_t constant_ms, uint32_t per_byte_us)
+{
+  pthread_mutex_lock (&mutex_);
+  write_constant_ms_ = constant_ms;
+  write_per_byte_us_ = per_byte_us;
+  pthread_mutex_unlock (&mutex_);
+}
+
+size_t
+UringChannel::write (const uint8_t *data, size_t length, std::error_code &ec)
+{
+  ring_->poll ();
+  pthread_mutex_lock (&mutex_);
+  if (tx_error_) {
+    ec = tx_error_;
+    tx_error_.clear ();
+    pthread_mutex_unlock (&mutex_);
+    return 0;
+  }
+  // All or nothing: a partly sent frame would desync the peer's parser.
+  size_t queued = tx_pending_.size () + tx_batch_.size () - tx_offset_;
+  if (length > (queued < uring_tx_limit ? uring_tx_limit - queued : 0)) {
+    ec = std::make_error_code (std::errc::no_buffer_space);
+    pthread_mutex_unlock (&mutex_);
+    return 0;
+  }
+  tx_pending_.insert (tx_pending_.end (), data, data + length);
+  if (!write_posted_) {
+    postWrite (false);
+  }
+  pthread_mutex_unlock (&mutex_);
+  return length;
+}
+
+bool
+UringChannel::takeError (std::error_code &ec)
+{
+  ring_->poll ();
+  pthread_mutex_lock (&mutex_);
+  if (tx_error_) {
+    ec = tx_error_;
+    tx_error_.clear ();
+  }
+  pthread_mutex_unlock (&mutex_);
+  return static_cast<bool> (ec);
+}
+
+bool
+UringChannel::waitWritten (uint32_t timeout_ms, std::error_code &ec)
+{
+  timespec deadline = uring_deadline (timeout_ms);
+  for (;;) {
+    unsigned generation = ring_->generation ();
+    pthread_mutex_lock (&mutex_);
+    bool waiting = (write_posted_ || !tx_pending_.empty ()) && !tx_error_;
+    pthread_mutex_unlock (&mutex_);
+    if (!waiting || !ring_->wait (generation, deadline)) {
+      break;
+    }
+  }
+  pthread_mutex_lock (&mutex_);
+  bool done = !write_posted_ && tx_pending_.empty () && !tx_error_;
+  if (tx_error_) {
+    ec = tx_error_;
+    tx_error_.clear ();
+  }
+  pthread_mutex_unlock (&mutex_);
+  return done;
+}
+
+size_t
+UringChannel::writePending ()
+{
+  ring_->poll ();
+  pthread_mutex_lock (&mutex_);
+  size_t pending = tx_pending_.size () + tx_batch_.size () - tx_offset_;
+  pthread_mutex_unlock (&mutex_);
+  return pending;
+}
+
+uint64_t
+UringChannel::bytesWritten ()
+{
+  ring_->poll ();
+  pthread_mutex_lock (&mutex_);
+  uint64_t written = tx_written_;
+  pthread_mutex_unlock (&mutex_);
+  return written;
+}
+
+#else // !SERIAL_HAVE_IO_URING
+
+// Built without io_uring headers: open() reports the backend as
+// unavailable and the select based path stays in use.
+
+namespace serial {
+class UringRing {};
+}
+
+UringChannel *
+UringChannel::open (int)
+{
+  return NULL;
+}
+
+UringChannel::~UringChannel () {}
+size_t UringChannel::available (std::error_code &) { return 0; }
+size_t UringChannel::read (uint8_t *, size_t, std::error_code &) { return 0; }
+bool UringChannel::waitReadable (uint32_t, std::error_code &) { return false; }
+void UringChannel::flushInput () {}
+void UringChannel::setWriteTimeout (uint32_t, uint32_t) {}
+size_t UringChannel::write (const uint8_t *, size_t, std::error_code &) { return 0; }
+bool UringChannel::takeError (std::error_code &) { return false; }
+bool UringChannel::waitWritten (uint32_t, std::error_code &) { return true; }
+size_t UringChannel::writePending () { return 0; }
+uint64_t UringChannel::bytesWritten () { return 0; }
+void UringChannel::onComplete (unsigned, int) {}
+
+#endif // SERIAL_HAVE_IO_URING
+
+#endif // !defined(_WIN32)
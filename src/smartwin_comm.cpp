@@ -1,23 +1,35 @@
 #include "smartwin_comm.h"
+#include "smartwin_def.h"
+#include "smartwin_time.h"
+#include <poll.h>
+#include <algorithm>
 
 namespace smartwin {
 
-smartwin_comm::smartwin_comm(std::string port_name, int baudrate, int timeout,
-        std::function<void(std::vector<uint8_t>)> callback) {  
+// 设备消失(拔出, 复位后重新枚举, pty主端关闭)时读写返回的错误, 需要重新打开串口
+static bool port_gone(const std::error_code& ec) {
+    return ec == std::errc::no_such_device
+        || ec == std::errc::no_such_device_or_address
+        || ec == std::errc::io_error
+        || ec == std::errc::bad_file_descriptor;
+}
+
+smartwin_comm::smartwin_comm(std::string port_name, int baudrate, int turnaround_ms,
+        std::function<void(std::vector<uint8_t>)> callback, bool threadless, bool io_uring) {  
 
     recv_callback_ = callback;
+    threadless_ = threadless;
 
-    printf("smartwin_comm port_name: %s, baudrate: %d\n", port_name.c_str(), baudrate);
+    pthread_mutex_init(&cmd_recv_mutex_, NULL);
 
-    serial::Timeout to = serial::Timeout::simpleTimeout(timeout);
-    to.write_timeout_constant = timeout;
-    to.read_timeout_constant = timeout;
-    to.read_timeout_multiplier = 10;
+    printf("smartwin_comm port_name: %s, baudrate: %d\n", port_name.c_str(), baudrate);
 
     _serial = new serial::Serial();
     _serial->setPort(port_name);
     _serial->setBaudrate(baudrate);
-    _serial->setTimeout(to);
+    set_timing(turnaround_ms, 200);
+    // 无线程模式由应用poll() fd, ring接管输入后fd不再可读, 只在接收线程模式下启用
+    _serial->setIoUring(io_uring && !threadless);
     
     try
     {
@@ -25,24 +37,43 @@ smartwin_comm::smartwin_comm(std::string port_name, int baudrate, int timeout,
     }
     catch(serial::IOException& e)
     {
+        // 设备尚未插入时按断开处理, 由接收线程(或process())重连
         printf("Err.Unable to open port. %s, err: %s\n", port_name.c_str(), e.what());
+        port_up_ = false;
+        lost_at_ms_ = smartwin_now_ms();
+        reopen_backoff_ms_ = reopen_min_ms_;
+        reopen_at_ms_ = lost_at_ms_ + reopen_backoff_ms_;
+    }
+
+    io_uring_ = _serial->getIoUring();
+    if(io_uring && !threadless && !io_uring_) {
+        printf("io_uring not available, use select\n");
+    }
+
+    if(threadless_) {
+        printf("smartwin_comm threadless mode, fd: %d\n", get_fd());
         return ;
     }
 
     thread_flag_ = true;
 
-    pthread_mutex_init(&cmd_recv_mutex_, NULL);
     pthread_create(&cmd_recv_thread_, NULL, &smartwin_comm::cmd_recv_thread_func, this);   
 
 }
 
 smartwin_comm::~smartwin_comm() {
-    thread_flag_ = false;
+    stop();
     pthread_mutex_destroy(&cmd_recv_mutex_);
-    pthread_join(cmd_recv_thread_, NULL);
     delete _serial;
 }
 
+void smartwin_comm::stop() {
+    if(thread_flag_) {
+        thread_flag_ = false;
+        pthread_join(cmd_recv_thread_, NULL);
+    }
+}
+
 std::string smartwin_comm::printBuf(std::string t_str, std::vector<uint8_t> buf) {
     return printBuf(t_str, buf.data(), buf.size());
 }
@@ -66,6 +97,9 @@ uint8_t smartwin_comm::xor_check(std::vector<uint8_t> buf) {
 }
 
 int smartwin_comm::sendcmd(std::vector<uint8_t> buf) {
+    if(!port_up_.load()) {
+        return SDK_LINK_LOST;
+    }
     if(!_serial->isOpen()) {
         return -110;
     }
@@ -81,9 +115,16 @@ int smartwin_comm::sendcmd(std::vector<uint8_t> buf) {
     sb.push_back(0x03);
     sb.push_back(xor_check(buf));
 
-    pthread_mutex_lock(&cmd_recv_mutex_);
-    int ret = _serial->write(sb.data(), sb.size());
-    pthread_mutex_unlock(&cmd_recv_mutex_);
+    // 无线程模式下收发都在调用者线程, 无需加锁
+    // 放入发送队列后立即返回, 大包(如4K图片数据)不再在持锁期间等待线路发完
+    std::error_code ec;
+    if(!threadless_) pthread_mutex_lock(&cmd_recv_mutex_);
+    int ret = _serial->writeAsync(sb.data(), sb.size(), ec);
+    if(!threadless_) pthread_mutex_unlock(&cmd_recv_mutex_);
+
+    if(ec) {
+        printf("send err: %s\n", ec.message().c_str());
+    }
 
 #ifdef SERIAL_DEBUG_INFO
     printf("sendcmd ret: %d, %s\n", ret, printBuf("send: ", sb).c_str());
@@ -92,82 +133,583 @@ int smartwin_comm::sendcmd(std::vector<uint8_t> buf) {
 
     if(ret != sb.size()) {
         printf("send Error: %d, %s\n", ret, printBuf("send: ", sb).c_str());
+        // 发送队列满时整帧未发出, 由本次请求返回错误; 其他错误(包括之前排队的数据发送失败)
+        // 说明有帧只发出了一部分或没有发出, 设备解析可能已失步, 按断开处理, 等待中的请求立即返回SDK_LINK_LOST
+        if(ec && ec != std::errc::no_buffer_space) {
+            port_lost(ec);
+            return SDK_LINK_LOST;
+        }
         return -1;
     }
     return 0;
 }
 
+void smartwin_comm::check_write_error() {
+    // 排队数据发送失败时尽快按断开处理, 不等到下一次sendcmd才发现
+    std::error_code ec;
+    if(port_up_.load() && _serial->takeWriteError(ec)) {
+        printf("queued write err: %s\n", ec.message().c_str());
+        port_lost(ec);
+    }
+}
+
+
+// 当前线程是否为接收线程, port_lost据此决定立即关闭串口还是交给接收线程
+static thread_local bool on_recv_thread = false;
 
 void* smartwin_comm::cmd_recv_thread_func(void* arg) {
     smartwin_comm* comm = (smartwin_comm*)arg;
+    on_recv_thread = true;
     printf("cmd_recv_thread_func start. %d\n", comm->thread_flag_);
 
+    // 热循环使用不抛异常的读接口, 超时和断开不走异常展开
+    std::error_code ec;
+
     while(comm->thread_flag_) {
 
+        // 串口已断开: 到期后尝试重新打开, 期间仍执行周期回调
+        if(!comm->port_up_.load() && !comm->port_reopen()) {
+            if(comm->tick_set_.load(std::memory_order_acquire)) {
+                comm->tick_callback_();
+            }
+            usleep(5*1000);
+            continue;
+        }
+
+        // 探测也要持锁: 其他线程会重新配置串口, 断开时串口可能刚被关闭
         std::vector<uint8_t> recv_buf;
-        try
+        pthread_mutex_lock(&comm->cmd_recv_mutex_);
+        size_t num = comm->port_up_.load() ? comm->_serial->available(ec) : 0;
+        if(!ec && num > 0)
         {
-            size_t num = comm->_serial->available();
-            if(num > 0)
-            {
-                pthread_mutex_lock(&comm->cmd_recv_mutex_);
-                // printf("_serial->available num: %d\n", num);
-
-                num = comm->_serial->read(comm->t_buffer, 1);
-                // printf("=1. _serial->available num: %d\n", num);
+            // printf("_serial->available num: %d\n", num);
 
-                if(num > 0) {
-                    if(comm->t_buffer[0] == 0x02) {
+            num = comm->_serial->read(comm->t_buffer, 1, ec);
+            // printf("=1. _serial->available num: %d\n", num);
 
-                        num = comm->_serial->read(comm->t_buffer, 4);
-                        // printf("=4. _serial->available num: %d\n", num);
+            if(!ec && num > 0) {
+                if(comm->t_buffer[0] == 0x02) {
+                    comm->frame_start_us_ = smartwin_now_us();
 
-                        if(num == 4) {
-                            recv_buf.push_back(comm->t_buffer[0]);
-                            recv_buf.push_back(comm->t_buffer[1]);
-                            recv_buf.push_back(comm->t_buffer[2]);
-                            recv_buf.push_back(comm->t_buffer[3]);
+                    num = comm->_serial->read(comm->t_buffer, 4, ec);
+                    // printf("=4. _serial->available num: %d\n", num);
 
-                            size_t ln = comm->t_buffer[2] * 256 + comm->t_buffer[3];
+                    if(!ec && num == 4) {
+                        recv_buf.push_back(comm->t_buffer[0]);
+                        recv_buf.push_back(comm->t_buffer[1]);
+                        recv_buf.push_back(comm->t_buffer[2]);
+                        recv_buf.push_back(comm->t_buffer[3]);
 
-                            num = comm->_serial->read(comm->t_buffer, ln);
+                        size_t ln = comm->t_buffer[2] * 256 + comm->t_buffer[3];
 
-                            // printf("=%d. _serial->available num: %d\n", ln, num);
-                            if(num == ln) {
-                                recv_buf.insert(recv_buf.end(), comm->t_buffer, comm->t_buffer + num);
+                        // 长度字段最大65535, 超过t_buffer, 数据直接读入recv_buf
+                        recv_buf.resize(4 + ln);
+                        num = comm->_serial->read(recv_buf.data() + 4, ln, ec);
 
-                                num = comm->_serial->read(comm->t_buffer, 2);
-                                // printf("=2. _serial->available num: %d\n", num);
+                        // printf("=%d. _serial->available num: %d\n", ln, num);
+                        if(!ec && num == ln) {
+                            num = comm->_serial->read(comm->t_buffer, 2, ec);
+                            // printf("=2. _serial->available num: %d\n", num);
 
-                                if(num == 2) {
-                                    if(comm->t_buffer[0] == 0x03 &&
-                                        comm->t_buffer[1] == comm->xor_check(recv_buf)) {
+                            if(!ec && num == 2) {
+                                if(comm->t_buffer[0] == 0x03 &&
+                                    comm->t_buffer[1] == comm->xor_check(recv_buf)) {
+                                    comm->frame_end_us_ = smartwin_now_us();
+                                    comm->frames_ok_++;
 
-                                        if(comm->recv_callback_) {
-                                            comm->recv_callback_(recv_buf);
-                                        }
-                                    }
-                                    else {
-                                        printf("%s\n", comm->printBuf("recv check error: ", recv_buf).c_str());
+                                    if(comm->recv_callback_) {
+                                        comm->recv_callback_(recv_buf);
                                     }
                                 }
+                                else {
+                                    comm->frames_bad_++;
+                                    printf("%s\n", comm->printBuf("recv check error: ", recv_buf).c_str());
+                                }
                             }
                         }
                     }
                 }
-                pthread_mutex_unlock(&comm->cmd_recv_mutex_);
+            }
+        }
+        pthread_mutex_unlock(&comm->cmd_recv_mutex_);
 
+        if(ec) {
+            if(port_gone(ec)) {
+                comm->port_lost(ec);
+            }
+            else {
+                printf("read_some err: %s\n", ec.message().c_str());
             }
+            ec.clear();
         }
-        catch(serial::IOException &err)
-        {
-            printf("read_some err: %s\n", err.what());
+        comm->check_write_error();
+
+        if(comm->tick_set_.load(std::memory_order_acquire)) {
+            comm->tick_callback_();
+        }
+
+        // 本轮已断开(串口已关闭或等待接收线程关闭), 不在串口上等待, 回到重连流程
+        if(!comm->port_up_.load()) {
+            continue;
         }
         
-        usleep(20*1000);
+        if(comm->low_latency_.load() && comm->io_uring_) {
+            // 在ring的接收完成上等待, 出错时退回固定休眠避免空转, 设备拔出时立即处理
+            std::error_code wec;
+            if(!comm->_serial->waitReadable(20, wec) && wec && !port_gone(wec)) {
+                usleep(20*1000);
+            }
+        }
+        else if(comm->low_latency_.load()) {
+            struct pollfd pfd;
+            pfd.fd = comm->_serial->getFd();
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            // 挂断或出错时poll会立即返回, 设备已拔出则立即处理, 否则退回固定休眠避免空转
+            if(poll(&pfd, 1, 20) > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+                std::error_code hec;
+                comm->_serial->available(hec);
+                if(!port_gone(hec)) {
+                    usleep(20*1000);
+                }
+            }
+        }
+        else {
+            usleep(20*1000);
+        }
     }
 
     return nullptr;
 }
 
+int smartwin_comm::set_low_latency(bool enable) {
+    int ret = SDK_OK;
+
+    // 重新配置串口时不能与接收线程的读取交错
+    if(!threadless_) pthread_mutex_lock(&cmd_recv_mutex_);
+    try
+    {
+        _serial->setLowLatency(enable);
+        low_latency_ = enable;
+    }
+    catch(serial::IOException &err)
+    {
+        printf("set_low_latency err: %s\n", err.what());
+        ret = SDK_ERROR;
+    }
+    if(!threadless_) pthread_mutex_unlock(&cmd_recv_mutex_);
+
+    return ret;
+}
+
+int smartwin_comm::set_timing(uint32_t turnaround_ms, uint32_t margin_pct) {
+    if(margin_pct < 100) {
+        return SDK_PARAMERR;
+    }
+
+    // 接收线程读取时不修改超时
+    pthread_mutex_lock(&cmd_recv_mutex_);
+    int ret = update_timing(turnaround_ms, margin_pct);
+    pthread_mutex_unlock(&cmd_recv_mutex_);
+    return ret;
+}
+
+int smartwin_comm::update_timing(uint32_t turnaround_ms, uint32_t margin_pct) {
+    uint32_t baudrate = _serial->getBaudrate();
+    if(baudrate == 0) {
+        return SDK_PARAMERR;
+    }
+
+    // 8N1, 与打开串口时的默认帧格式一致
+    serial::Timeout to = serial::Timeout::fromBaudrate(baudrate, turnaround_ms,
+        serial::eightbits, serial::parity_none, serial::stopbits_one, margin_pct);
+
+    timing_.baudrate = baudrate;
+    timing_.byte_time_ns = serial::Timeout::byteTimeNs(baudrate);
+    timing_.margin_pct = margin_pct;
+    timing_.per_byte_us = to.read_timeout_multiplier_us;
+    timing_.turnaround_ms = turnaround_ms;
+    timing_.max_frame_ms = frame_timeout_ms(4096 + 7);
+
+    _serial->setTimeout(to);
+
+    printf("serial timing: %u baud, byte %u ns, per byte %u us, turnaround %u ms, 4K frame %u ms\n",
+        timing_.baudrate, timing_.byte_time_ns, timing_.per_byte_us,
+        timing_.turnaround_ms, timing_.max_frame_ms);
+    return SDK_OK;
+}
+
+int smartwin_comm::set_baudrate(uint32_t baudrate) {
+    if(baudrate == 0) {
+        return SDK_PARAMERR;
+    }
+
+    // 已排队的命令按原波特率发完. 等待时不持锁, 不阻塞接收线程;
+    // 持锁后发现等待期间又有命令排队则再等一轮
+    std::error_code ec;
+    for(int i = 0; ; i++) {
+        _serial->waitWriteComplete(frame_timeout_ms(4096 + 7), ec);
+        pthread_mutex_lock(&cmd_recv_mutex_);
+        if(i >= 3 || ec || _serial->waitWriteComplete(0, ec) || ec) {
+            break;
+        }
+        pthread_mutex_unlock(&cmd_recv_mutex_);
+    }
+
+    uint32_t old_baudrate = _serial->getBaudrate();
+    int ret = SDK_OK;
+    try
+    {
+        _serial->setBaudrate(baudrate);
+        if(_serial->isOpen()) {
+            _serial->flushInput();
+        }
+    }
+    catch(std::exception& e)
+    {
+        printf("set baudrate %u err: %s\n", baudrate, e.what());
+        ret = SDK_ERROR;
+        try
+        {
+            _serial->setBaudrate(old_baudrate);
+        }
+        catch(std::exception& e)
+        {
+        }
+    }
+    frame_reset();
+    update_timing(timing_.turnaround_ms, timing_.margin_pct);
+    pthread_mutex_unlock(&cmd_recv_mutex_);
+    return ret;
+}
+
+int smartwin_comm::set_flow_control(bool enable) {
+    pthread_mutex_lock(&cmd_recv_mutex_);
+    int ret = SDK_OK;
+    try
+    {
+        _serial->setFlowcontrol(enable ? serial::flowcontrol_hardware : serial::flowcontrol_none);
+    }
+    catch(std::exception& e)
+    {
+        printf("set flow control err: %s\n", e.what());
+        ret = SDK_ERROR;
+    }
+    pthread_mutex_unlock(&cmd_recv_mutex_);
+    return ret;
+}
+
+int smartwin_comm::start_modem_monitor(serial::ModemCallback callback) {
+    // 保存回调, 重连后重新启动监视
+    modem_callback_ = callback;
+    return _serial->startModemMonitor(callback) ? SDK_OK : SDK_ERROR;
+}
+
+void smartwin_comm::set_reconnect(uint32_t min_ms, uint32_t max_ms) {
+    if(!threadless_) pthread_mutex_lock(&cmd_recv_mutex_);
+    reopen_min_ms_ = min_ms > 0 ? min_ms : 1;
+    reopen_max_ms_ = max_ms;
+    if(!threadless_) pthread_mutex_unlock(&cmd_recv_mutex_);
+}
+
+void smartwin_comm::set_link_callback(std::function<void(bool, uint32_t)> callback) {
+    if(!threadless_) pthread_mutex_lock(&cmd_recv_mutex_);
+    link_callback_ = callback;
+    if(!threadless_) pthread_mutex_unlock(&cmd_recv_mutex_);
+}
+
+void smartwin_comm::link_notify(bool up, uint32_t down_ms) {
+    std::function<void(bool, uint32_t)> callback;
+    if(!threadless_) pthread_mutex_lock(&cmd_recv_mutex_);
+    callback = link_callback_;
+    if(!threadless_) pthread_mutex_unlock(&cmd_recv_mutex_);
+    if(callback) {
+        callback(up, down_ms);
+    }
+}
+
+void smartwin_comm::port_lost(const std::error_code& err) {
+    if(!port_up_.load()) {
+        return;
+    }
+
+    // 监视线程的回调会调用flush_input(), 须在持锁关闭串口之前停止
+    _serial->stopModemMonitor();
+
+    if(!threadless_) pthread_mutex_lock(&cmd_recv_mutex_);
+    printf("serial link lost: %s, reconnecting\n", err.message().c_str());
+    // 接收线程可能正在锁外等待串口可读(io_uring通道, fd), 其他线程只标记断开, 由接收线程关闭
+    if(threadless_ || on_recv_thread) {
+        port_close();
+    }
+    else {
+        close_pending_ = true;
+    }
+    frame_reset();
+    port_up_ = false;
+    lost_at_ms_ = smartwin_now_ms();
+    reopen_backoff_ms_ = reopen_min_ms_;
+    reopen_at_ms_ = lost_at_ms_ + reopen_backoff_ms_;
+    if(!threadless_) pthread_mutex_unlock(&cmd_recv_mutex_);
+
+    link_notify(false, 0);
+}
+
+void smartwin_comm::port_close() {
+    // 调用者持有cmd_recv_mutex_(无线程模式不加锁)
+    close_pending_ = false;
+    try
+    {
+        _serial->close();
+    }
+    catch(std::exception& e)
+    {
+        printf("close err: %s\n", e.what());
+    }
+}
+
+bool smartwin_comm::port_reopen() {
+    // 其他线程发现的断开, 串口在接收线程中关闭
+    if(!threadless_) {
+        pthread_mutex_lock(&cmd_recv_mutex_);
+        if(close_pending_) {
+            port_close();
+        }
+        pthread_mutex_unlock(&cmd_recv_mutex_);
+    }
+
+    uint64_t now = smartwin_now_ms();
+    if(reopen_max_ms_ == 0 || now < reopen_at_ms_) {
+        return false;
+    }
+
+    if(!threadless_) pthread_mutex_lock(&cmd_recv_mutex_);
+    bool ok = true;
+    try
+    {
+        // 串口对象保留了波特率, 超时, 流控, 低延迟和io_uring配置, open()时重新应用
+        _serial->open();
+        _serial->flushInput();
+    }
+    catch(std::exception&)
+    {
+        // 设备尚未重新出现, 按退避时间继续尝试
+        ok = false;
+        try
+        {
+            _serial->close();
+        }
+        catch(std::exception&)
+        {
+        }
+    }
+    uint32_t down_ms = (uint32_t)(now - lost_at_ms_);
+    if(ok) {
+        frame_reset();
+        io_uring_ = _serial->getIoUring();
+        port_up_ = true;
+        reconnects_++;
+        printf("serial link reconnected after %u ms\n", down_ms);
+    }
+    else {
+        reopen_at_ms_ = now + reopen_backoff_ms_;
+        reopen_backoff_ms_ = std::min(reopen_backoff_ms_ * 2, reopen_max_ms_);
+    }
+    if(!threadless_) pthread_mutex_unlock(&cmd_recv_mutex_);
+
+    if(ok) {
+        if(modem_callback_) {
+            _serial->startModemMonitor(modem_callback_);
+        }
+        link_notify(true, down_ms);
+    }
+    return ok;
+}
+
+void smartwin_comm::flush_input() {
+    pthread_mutex_lock(&cmd_recv_mutex_);
+    try
+    {
+        if(_serial->isOpen()) {
+            _serial->flushInput();
+        }
+    }
+    catch(std::exception& e)
+    {
+        printf("flush input err: %s\n", e.what());
+    }
+    frame_reset();
+    pthread_mutex_unlock(&cmd_recv_mutex_);
+}
+
+int smartwin_comm::frame_timeout_ms(size_t bytes) const {
+    return (int)(timing_.turnaround_ms + ((uint64_t)timing_.per_byte_us * bytes + 999) / 1000);
+}
+
+int smartwin_comm::get_fd() {
+    return _serial->getFd();
+}
+
+int smartwin_comm::get_timeout() {
+    uint64_t now = smartwin_now_ms();
+    if(!port_up_.load()) {
+        // 下一次重连尝试
+        if(reopen_max_ms_ == 0) {
+            return -1;
+        }
+        return now >= reopen_at_ms_ ? 0 : (int)(reopen_at_ms_ - now);
+    }
+    if(frame_state_ == FRAME_STX) {
+        return -1;
+    }
+    if(now >= frame_deadline_) {
+        return 0;
+    }
+    return (int)(frame_deadline_ - now);
+}
+
+void smartwin_comm::frame_reset() {
+    frame_state_ = FRAME_STX;
+    frame_need_ = 0;
+    frame_buf_.clear();
+}
+
+int smartwin_comm::parse_bytes(const uint8_t* data, size_t len) {
+    int frames = 0;
+
+    for(size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+
+        switch(frame_state_) {
+        case FRAME_STX:
+            if(b == 0x02) {
+                frame_start_us_ = smartwin_now_us();
+                frame_buf_.clear();
+                frame_need_ = 4;
+                frame_state_ = FRAME_HEAD;
+                frame_deadline_ = smartwin_now_ms() + frame_timeout_ms(5);
+            }
+            break;
+        case FRAME_HEAD:
+            frame_buf_.push_back(b);
+            if(--frame_need_ == 0) {
+                frame_need_ = frame_buf_[2] * 256 + frame_buf_[3];
+                frame_state_ = frame_need_ > 0 ? FRAME_DATA : FRAME_ETX;
+                // 长度已知, 按整帧的线路时间放宽期限
+                frame_deadline_ += frame_timeout_ms(frame_need_ + 2) - timing_.turnaround_ms;
+            }
+            break;
+        case FRAME_DATA: {
+            // 数据段整段拷贝, 避免逐字节push_back
+            size_t n = std::min(frame_need_, len - i);
+            frame_buf_.insert(frame_buf_.end(), data + i, data + i + n);
+            frame_need_ -= n;
+            i += n - 1;
+            if(frame_need_ == 0) {
+                frame_state_ = FRAME_ETX;
+            }
+            break;
+        }
+        case FRAME_ETX:
+            if(b == 0x03) {
+                frame_state_ = FRAME_LRC;
+            } else {
+                frames_bad_++;
+                printf("%s\n", printBuf("recv etx error: ", frame_buf_).c_str());
+                frame_reset();
+            }
+            break;
+        case FRAME_LRC:
+            if(b == xor_check(frame_buf_)) {
+                frame_end_us_ = smartwin_now_us();
+                frames_ok_++;
+                if(recv_callback_) {
+                    recv_callback_(frame_buf_);
+                }
+                frames++;
+            }
+            else {
+                frames_bad_++;
+                printf("%s\n", printBuf("recv check error: ", frame_buf_).c_str());
+            }
+            frame_reset();
+            break;
+        }
+    }
+
+    return frames;
+}
+
+int smartwin_comm::process() {
+    if(!port_up_.load() && !port_reopen()) {
+        return SDK_LINK_LOST;
+    }
+    if(!_serial->isOpen()) {
+        return SDK_ERROR;
+    }
+
+    // 半帧超时, 丢弃后重新同步到下一个0x02
+    if(frame_state_ != FRAME_STX && smartwin_now_ms() >= frame_deadline_) {
+        printf("%s\n", printBuf("recv frame timeout: ", frame_buf_).c_str());
+        frame_reset();
+    }
+
+    check_write_error();
+    if(!port_up_.load()) {
+        return SDK_LINK_LOST;
+    }
+
+    int frames = 0;
+    std::error_code ec;
+    size_t num = _serial->available(ec);
+    while(!ec && num > 0) {
+        size_t n = _serial->read(t_buffer, std::min(num, sizeof(t_buffer)), ec);
+        if(n > 0) {
+            frames += parse_bytes(t_buffer, n);
+        }
+        if(ec || n == 0) {
+            break;
+        }
+        num = _serial->available(ec);
+    }
+
+    if(ec) {
+        if(port_gone(ec)) {
+            port_lost(ec);
+            return SDK_LINK_LOST;
+        }
+        printf("process err: %s\n", ec.message().c_str());
+        return SDK_ERROR;
+    }
+
+    return frames;
+}
+
+int smartwin_comm::process_wait(int timeout_ms) {
+    struct pollfd pfd;
+    pfd.fd = get_fd();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int t = get_timeout();
+    if(t >= 0 && t < timeout_ms) {
+        timeout_ms = t;
+    }
+
+    if(pfd.fd < 0) {
+        // 断开期间没有fd, 等到下一次重连尝试
+        if(port_up_.load()) {
+            return SDK_ERROR;
+        }
+        if(timeout_ms < 0) {
+            return SDK_LINK_LOST;
+        }
+        usleep(timeout_ms * 1000);
+        return process();
+    }
+
+    poll(&pfd, 1, timeout_ms);
+    return process();
+}
+
 }
@@ -1,124 +1,998 @@
 #include "smartwin_devices.h"
 #include "smartwin_cmd.h"
+#include "smartwin_time.h"
+#include <sys/eventfd.h>
+#include <algorithm>
 
 namespace smartwin {
 
+bool smartwin_devices::threadless_mode_ = false;
+bool smartwin_devices::low_latency_mode_ = false;
+bool smartwin_devices::io_uring_mode_ = false;
+std::string smartwin_devices::port_name_ = "/dev/ttyS1";
+int smartwin_devices::baudrate_ = 460800;
+bool smartwin_devices::flow_control_ = false;
+uint8_t smartwin_devices::link_lines_ = 0;
+bool smartwin_devices::link_replay_ = false;
+bool smartwin_devices::autobaud_ = false;
+uint32_t smartwin_devices::reconnect_min_ms_ = 10;
+uint32_t smartwin_devices::reconnect_max_ms_ = 200;
+
+// 默认可重发的命令: 查询类和设置固定状态类, 重复执行与执行一次效果相同
+static const uint8_t replay_cmds[] = {
+    CMD_GET_NETWORK_MODE, CMD_GET_SYSTEM_VERSION, CMD_GET_HARDWARE_SERIAL_NUMBER,
+    CMD_GET_DEVICE_MODEL, CMD_GET_CUSTOMER_SERIAL_NUMBER, CMD_GET_CLOCK,
+    CMD_LED_ON, CMD_LED_OFF, CMD_GET_CHIP_SERIAL_NUMBER,
+    CMD_SET_KEYBOARD_SOUND, CMD_SET_KEYBOARD_BACKLIGHT, CMD_CHECK_TP_SUPPORT,
+    CMD_SET_TOUCH_PARAMETER, CMD_CHECK_IC_STATUS, CMD_CHECK_PRINTER_SUPPORT,
+    CMD_QUERY_PRINTER_STATUS, CMD_SET_PRINTER_GRAY, CMD_KEYPAD_CHECK_TRIGGER_STATUS,
+};
+
+// 库内部任务(触摸上报间隔, 波特率回退)在执行器中的排序键, 与命令字不重叠
+static const uint32_t INTERNAL_TASK_KEY = 0x100;
+
+thread_local smartwin_devices::request_record smartwin_devices::current_request_ = {};
+
+static std::vector<uint8_t> request_frame(uint8_t cmd, const std::vector<uint8_t>& params) {
+    std::vector<uint8_t> buf;
+
+    buf.push_back(cmd);
+    buf.push_back(0x2F);
+    buf.push_back(params.size()/256);
+    buf.push_back(params.size()%256);
+
+    for(auto param : params) {
+        buf.push_back(param);
+    }
+    return buf;
+}
+
 smartwin_devices::smartwin_devices() {
 
-    pthread_mutex_init(&keyinput_list_mutex_, NULL);
+    pthread_mutex_init(&key_wait_mutex_, NULL);
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&key_wait_cond_, &cond_attr);
+    pthread_cond_init(&search_card_cond_, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    key_waiters_ = 0;
+    key_pushed_ = 0;
+    key_dropped_ = 0;
+    key_max_depth_ = 0;
+    touch_pushed_ = 0;
+    touch_dropped_ = 0;
+    touch_max_depth_ = 0;
+    touch_gap_ms_ = 100;
+    touch_last_.action = SW_TOUCH_UP;
+    for(int i = 0; i < 256; i++) {
+        replay_cmd_[i] = false;
+    }
+    for(auto cmd : replay_cmds) {
+        replay_cmd_[cmd] = true;
+    }
     pthread_mutex_init(&search_card_list_mutex_, NULL);
-    pthread_mutex_init(&tpinput_list_mutex_, NULL);
     pthread_mutex_init(&icstatus_list_mutex_, NULL);
     pthread_mutex_init(&recv_list_mutex_, NULL);
+    pthread_mutex_init(&event_callback_mutex_, NULL);
+    pthread_mutex_init(&event_list_mutex_, NULL);
+
+    // 无线程模式下回调在process()中执行.
+    // 按键/寻卡, 触摸/IC卡状态, 库内部任务各用一条通道, 触摸积压或内部任务等待应答不延迟按键回调
+    executor_ = new smartwin_executor(threadless_mode_ ? 0 : 3, 64);
+    executor_->bind(CMD_READ_KEYBOARD_INPUT, 0);
+    executor_->bind(CMD_SEARCH_CARD_START, 0);
+    executor_->bind(CMD_GET_TOUCH_COORDINATE, 1);
+    executor_->bind(CMD_CHECK_IC_STATUS, 1);
+    executor_->bind(INTERNAL_TASK_KEY, 2);
+    timeout_policy_ = new smartwin_timeout_policy();
+
+    presence_ = new smartwin_presence(
+        [this](uint8_t cmd, std::vector<uint8_t> params) { return send_request(request_frame(cmd, params), REQUEST_PRESENCE); },
+        [this]() { return app_request_pending(); },
+        [this](const smartwin_event& ev) { push_event(ev); });
+
+    touch_rate_ = new smartwin_touch_rate();
+    link_rate_ = new smartwin_link_rate();
+    tp_area_[0] = 0;
+    tp_area_[1] = 0;
+    tp_area_[2] = 319;
+    tp_area_[3] = 239;
+
+    dispatcher_ = new smartwin_dispatcher();
+    dispatcher_->set_queue(SW_QUEUE_RESPONSE, [this](const std::vector<uint8_t>& buf, uint8_t policy) {
+        response_frame frame = {buf, _comm->frame_end_us()};
+        pthread_mutex_lock(&recv_list_mutex_);
+        if(policy == SW_POLICY_KEEP_LATEST) {
+            recv_list.clear();
+        }
+        if(!recv_list.push(frame)) {
+            printf("%s\n", _comm->printBuf("Err. queue full, drop frame: ", buf).c_str());
+        }
+        pthread_mutex_unlock(&recv_list_mutex_);
+    });
+    dispatcher_->set_queue(SW_QUEUE_KEY, [this](const std::vector<uint8_t>& buf, uint8_t) {
+        push_key_event(buf);
+    });
+    dispatcher_->set_queue(SW_QUEUE_TOUCH, [this](const std::vector<uint8_t>& buf, uint8_t) {
+        push_touch_point(buf);
+    });
+    dispatcher_->set_queue(SW_QUEUE_SEARCH_CARD, [this](const std::vector<uint8_t>& buf, uint8_t policy) {
+        push_search_card(buf, policy);
+    });
+    dispatcher_->set_queue(SW_QUEUE_IC_STATUS, [this](const std::vector<uint8_t>& buf, uint8_t policy) {
+        push_list(icstatus_list, icstatus_list_mutex_, buf, policy);
+    });
 
     if(_comm == nullptr) {
-        // 安全芯片端口: /dev/ttyS1, 波特率: 460800
-        _comm = new smartwin_comm("/dev/ttyS1", 460800, 500, [&](std::vector<uint8_t> buf) {
+        // 安全芯片端口: 默认/dev/ttyS1, 波特率: 460800
+        // 串口读写超时 = 50ms固件余量 + 按波特率计算的线路时间, 4K帧约230ms
+        _comm = new smartwin_comm(port_name_, baudrate_, 50, [&](std::vector<uint8_t> buf) {
 
             printf("callback: %s\n", _comm->printBuf("recv: ", buf).c_str());
 
-            // 读取键盘输入
-            if (CMD_READ_KEYBOARD_INPUT == buf[0] && 0x4F == buf[1]) {
-                pthread_mutex_lock(&keyinput_list_mutex_);
-                keyinput_list.push_back(buf);
-                pthread_mutex_unlock(&keyinput_list_mutex_);
+            // 已取消操作的迟到应答
+            if (discard_frame(buf)) {
+                return;
             }
-            else if (CMD_SEARCH_CARD_START == buf[0] && 0x4F == buf[1]) {
-                pthread_mutex_lock(&search_card_list_mutex_);
-                search_card_list.push_back(buf);
-                pthread_mutex_unlock(&search_card_list_mutex_);
-            } 
-            else if (CMD_GET_TOUCH_COORDINATE == buf[0] && 0x4F == buf[1])
-            {
-                pthread_mutex_lock(&tpinput_list_mutex_);
-                tpinput_list.push_back(buf);
-                pthread_mutex_unlock(&tpinput_list_mutex_);
+
+            // 后台在位检测的应答, 同命令字的应用请求在前时交给应用
+            if (presence_response(buf) && presence_->on_response(buf)) {
+                return;
             }
-            else if (CMD_CHECK_IC_STATUS == buf[0] && 0x4F == buf[1])
-            {
-                pthread_mutex_lock(&icstatus_list_mutex_);
-                icstatus_list.push_back(buf);
-                pthread_mutex_unlock(&icstatus_list_mutex_);
+
+            const smartwin_dispatch_entry& entry = dispatcher_->dispatch(buf);
+            if ((entry.kind & SW_FRAME_EVENT) && entry.decoder != nullptr) {
+                push_event(buf, entry.decoder);
             }
-            else {
-                pthread_mutex_lock(&recv_list_mutex_);
-                recv_list.push_back(buf);
-                pthread_mutex_unlock(&recv_list_mutex_);
+            post_event_callback(buf);
+        }, threadless_mode_, io_uring_mode_);
+
+        _comm->set_reconnect(reconnect_min_ms_, reconnect_max_ms_);
+        port_up_ = _comm->port_is_up();
+        _comm->set_link_callback([this](bool up, uint32_t down_ms) { on_port_event(up, down_ms); });
+        if(flow_control_) {
+            _comm->set_flow_control(true);
+        }
+        _comm->set_tick_callback([this]() { tick(); });
+        if(link_lines_ != 0) {
+            if(_comm->start_modem_monitor([this](const serial::ModemEvent& ev) { on_modem_event(ev); }) != SDK_OK) {
+                printf("Err. modem monitor not available on %s\n", port_name_.c_str());
             }
-        });
+        }
+        if(low_latency_mode_) {
+            _comm->set_low_latency(true);
+        }
     }
 }
 
 smartwin_devices::~smartwin_devices() {
+    // 接收线程的回调和tick()向执行器投递任务, 任务中使用_comm(触摸参数, 波特率回退);
+    // 先停接收线程, 再等执行器任务结束, 最后释放_comm
+    if(_comm != nullptr) {
+        _comm->stop();
+    }
+    if(executor_ != nullptr) {
+        delete executor_;
+    }
+    if(presence_ != nullptr) {
+        delete presence_;
+    }
+    if(link_rate_ != nullptr) {
+        delete link_rate_;
+    }
+    if(touch_rate_ != nullptr) {
+        delete touch_rate_;
+    }
+    if(dispatcher_ != nullptr) {
+        delete dispatcher_;
+    }
+    if(timeout_policy_ != nullptr) {
+        delete timeout_policy_;
+    }
     if(_comm != nullptr) {
         delete _comm;
     }
+    if(event_fd_ >= 0) {
+        close(event_fd_);
+    }
+}
+
+int smartwin_devices::get_fd() {
+    return _comm->get_fd();
+}
+
+int smartwin_devices::get_timeout() {
+    int t = _comm->get_timeout();
+    int p = presence_->get_timeout();
+    if(p >= 0 && (t < 0 || p < t)) {
+        t = p;
+    }
+    return t;
+}
+
+int smartwin_devices::process() {
+    int ret = _comm->process();
+    tick();
+    executor_->run_pending();
+    return ret;
+}
+
+int smartwin_devices::set_event_callback(uint8_t cmd, std::function<void(std::vector<uint8_t>)> callback) {
+    pthread_mutex_lock(&event_callback_mutex_);
+    event_callbacks_[cmd] = callback;
+    pthread_mutex_unlock(&event_callback_mutex_);
+    return SDK_OK;
+}
+
+int smartwin_devices::get_executor_stats(smartwin_executor_stats& stats) {
+    executor_->get_stats(stats);
+    return SDK_OK;
+}
+
+int smartwin_devices::get_timeout_info(uint8_t cmd, smartwin_timeout_info& info) {
+    timeout_policy_->get_info(cmd, info);
+    return SDK_OK;
+}
+
+int smartwin_devices::set_timeout_config(uint8_t cmd, const smartwin_timeout_config& config) {
+    return timeout_policy_->set_config(cmd, config);
+}
+
+int smartwin_devices::presence_enable(uint8_t slots, uint8_t card_type, uint8_t card_seat) {
+    presence_->enable(slots, card_type, card_seat);
+    return SDK_OK;
+}
+
+int smartwin_devices::presence_boost() {
+    presence_->boost();
+    return SDK_OK;
+}
+
+int smartwin_devices::register_frame_handler(uint8_t cmd, const smartwin_dispatch_entry& entry) {
+    if(entry.queue >= SW_QUEUE_EVENT) {
+        return SDK_PARAMERR;
+    }
+    dispatcher_->set_entry(cmd, entry);
+    return SDK_OK;
+}
+
+int smartwin_devices::get_queue_stats(uint8_t queue, smartwin_queue_stats& stats) {
+    switch(queue) {
+    case SW_QUEUE_RESPONSE:
+        pthread_mutex_lock(&recv_list_mutex_);
+        recv_list.get_stats(stats);
+        pthread_mutex_unlock(&recv_list_mutex_);
+        return SDK_OK;
+    case SW_QUEUE_SEARCH_CARD:
+        pthread_mutex_lock(&search_card_list_mutex_);
+        search_card_list.get_stats(stats);
+        pthread_mutex_unlock(&search_card_list_mutex_);
+        return SDK_OK;
+    case SW_QUEUE_IC_STATUS:
+        pthread_mutex_lock(&icstatus_list_mutex_);
+        icstatus_list.get_stats(stats);
+        pthread_mutex_unlock(&icstatus_list_mutex_);
+        return SDK_OK;
+    case SW_QUEUE_EVENT:
+        pthread_mutex_lock(&event_list_mutex_);
+        event_list.get_stats(stats);
+        pthread_mutex_unlock(&event_list_mutex_);
+        return SDK_OK;
+    case SW_QUEUE_KEY:
+        stats.capacity = key_ring_.capacity();
+        stats.depth = key_ring_.size();
+        stats.max_depth = key_max_depth_;
+        stats.policy = SW_OVERFLOW_DROP_NEWEST;
+        stats.pushed = key_pushed_;
+        stats.dropped = key_dropped_;
+        return SDK_OK;
+    case SW_QUEUE_TOUCH:
+        stats.capacity = touch_ring_.capacity();
+        stats.depth = touch_ring_.size();
+        stats.max_depth = touch_max_depth_;
+        stats.policy = SW_OVERFLOW_DROP_NEWEST;
+        stats.pushed = touch_pushed_;
+        stats.dropped = touch_dropped_;
+        return SDK_OK;
+    }
+    return SDK_PARAMERR;
+}
+
+int smartwin_devices::set_queue_config(uint8_t queue, uint32_t capacity, uint8_t policy) {
+    if(capacity == 0 || policy > SW_OVERFLOW_COALESCE) {
+        return SDK_PARAMERR;
+    }
+
+    pthread_mutex_t* mutex = nullptr;
+    switch(queue) {
+    case SW_QUEUE_RESPONSE:
+        mutex = &recv_list_mutex_;
+        break;
+    case SW_QUEUE_SEARCH_CARD:
+        mutex = &search_card_list_mutex_;
+        break;
+    case SW_QUEUE_IC_STATUS:
+        mutex = &icstatus_list_mutex_;
+        break;
+    case SW_QUEUE_EVENT:
+        mutex = &event_list_mutex_;
+        break;
+    default:
+        return SDK_PARAMERR;
+    }
+
+    pthread_mutex_lock(mutex);
+    if(queue == SW_QUEUE_RESPONSE) {
+        recv_list.set_config(capacity, policy);
+    }
+    else if(queue == SW_QUEUE_SEARCH_CARD) {
+        search_card_list.set_config(capacity, policy);
+    }
+    else if(queue == SW_QUEUE_IC_STATUS) {
+        icstatus_list.set_config(capacity, policy);
+    }
+    else {
+        event_list.set_config(capacity, policy);
+    }
+    pthread_mutex_unlock(mutex);
+    return SDK_OK;
+}
+
+void smartwin_devices::post_event_callback(const std::vector<uint8_t>& buf) {
+    std::function<void(std::vector<uint8_t>)> cb;
+
+    pthread_mutex_lock(&event_callback_mutex_);
+    cb = event_callbacks_[buf[0]];
+    pthread_mutex_unlock(&event_callback_mutex_);
+
+    if(cb) {
+        executor_->post(buf[0], [cb, buf]() { cb(buf); });
+    }
+}
+
+void smartwin_devices::tick() {
+    presence_->tick();
+    search_card_poll_cancel();
+
+    // 应用有请求未应答时推迟下发, 不与应用命令争用链路
+    uint32_t interval = app_request_pending() ? 0 : touch_rate_->tick(smartwin_now_ms());
+    if(interval > 0) {
+        // tp_set_parameter要等待应答, 不能在接收线程中执行; 应答按请求匹配, 与应用命令并发也不会互相取走
+        int ret = executor_->post(INTERNAL_TASK_KEY, [this, interval]() {
+            if(app_request_pending()) {
+                touch_rate_->applied(interval, false);
+                return;
+            }
+            int ret = tp_set_parameter(tp_area_[0], tp_area_[1], tp_area_[2], tp_area_[3], interval);
+            touch_rate_->applied(interval, ret == SDK_OK);
+        });
+        if(ret != SDK_OK) {
+            touch_rate_->applied(interval, false);
+        }
+    }
+
+    uint32_t ok, bad;
+    _comm->get_frame_stats(ok, bad);
+    uint32_t rate = link_rate_->tick(smartwin_now_ms(), ok, bad);
+    if(rate > 0 && !link_rate_switching_.exchange(true)) {
+        // 切换前要等已排队的数据按原波特率发完, 不能在接收线程中执行
+        printf("link error rate too high, fall back to %u baud\n", rate);
+        int ret = executor_->post(INTERNAL_TASK_KEY, [this, rate]() {
+            _comm->set_baudrate(rate);
+            link_rate_switching_ = false;
+        });
+        if(ret != SDK_OK) {
+            link_rate_switching_ = false;
+        }
+    }
+}
+
+void smartwin_devices::recv_wait(int ms) {
+    if(threadless_mode_) {
+        // 无线程模式: 在调用者线程内等待串口并完成解析
+        _comm->process_wait(ms);
+    } else {
+        usleep(ms * 1000);
+    }
+}
+
+void smartwin_devices::push_event(const std::vector<uint8_t>& buf, smartwin_frame_decoder decoder) {
+    if(event_fd_ < 0) {
+        return;
+    }
+
+    smartwin_event ev;
+    if(!decoder(buf, ev)) {
+        return;
+    }
+    // 触摸动作由push_touch_point按上报间隔判断, 它在分发时已先处理了这一帧
+    if(ev.type == SW_EVENT_TOUCH) {
+        ev.touch.action = touch_push_action_;
+    }
+    ev.rx_start_us = _comm->frame_start_us();
+    ev.timestamp_us = _comm->frame_end_us();
+    push_event(ev);
+}
+
+void smartwin_devices::push_list(smartwin_bounded_queue<std::vector<uint8_t>>& list, pthread_mutex_t& mutex,
+        const std::vector<uint8_t>& buf, uint8_t policy) {
+    pthread_mutex_lock(&mutex);
+    if(policy == SW_POLICY_KEEP_LATEST) {
+        list.clear();
+    }
+    if(!list.push(buf)) {
+        printf("%s\n", _comm->printBuf("Err. queue full, drop frame: ", buf).c_str());
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void smartwin_devices::on_modem_event(const serial::ModemEvent& ev) {
+    bool up = (ev.lines & link_lines_) == link_lines_;
+    bool was_up = link_up_.load();
+
+    if(!up) {
+        if(was_up) {
+            link_epoch_++;
+            printf("secure chip link down, lines: 0x%02x\n", ev.lines);
+        }
+        link_up_ = false;
+    }
+    else if(!was_up || (ev.changed & link_lines_)) {
+        // 重新上电, 或两次读取之间完成的复位脉冲: 之前的请求作废, 丢弃上电过程中的残留字节
+        if(was_up) {
+            link_epoch_++;
+        }
+        _comm->flush_input();
+        pthread_mutex_lock(&recv_list_mutex_);
+        recv_list.clear();
+        pthread_mutex_unlock(&recv_list_mutex_);
+        link_up_ = true;
+        printf("secure chip link up, lines: 0x%02x\n", ev.lines);
+    }
+
+    smartwin_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = SW_EVENT_MODEM;
+    event.timestamp_us = ev.timestamp_us;
+    event.rx_start_us = 0;
+    event.modem.lines = (uint8_t)ev.lines;
+    event.modem.changed = (uint8_t)ev.changed;
+    event.modem.link_up = up ? 1 : 0;
+    push_event(event);
+}
+
+void smartwin_devices::on_port_event(bool up, uint32_t down_ms) {
+    if(!up) {
+        port_epoch_++;
+        port_up_ = false;
+    }
+    else {
+        // 重新打开前收到的应答都属于断开前的请求
+        pthread_mutex_lock(&recv_list_mutex_);
+        recv_list.clear();
+        pthread_mutex_unlock(&recv_list_mutex_);
+        port_up_ = true;
+    }
+
+    smartwin_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = SW_EVENT_LINK;
+    event.timestamp_us = smartwin_now_us();
+    event.rx_start_us = 0;
+    event.link.up = up ? 1 : 0;
+    event.link.down_ms = down_ms;
+    event.link.reconnects = _comm->get_reconnect_count();
+    push_event(event);
+}
+
+int smartwin_devices::set_replay_command(uint8_t cmd, bool idempotent) {
+    replay_cmd_[cmd] = idempotent;
+    return SDK_OK;
+}
+
+void smartwin_devices::push_event(const smartwin_event& ev) {
+    if(event_fd_ < 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&event_list_mutex_);
+    bool queued = event_list.push(ev);
+    pthread_mutex_unlock(&event_list_mutex_);
+
+    if(!queued) {
+        return;
+    }
+
+    uint64_t one = 1;
+    if(write(event_fd_, &one, sizeof(one)) != sizeof(one)) {
+        printf("Err. eventfd write failed\n");
+    }
+}
+
+int smartwin_devices::event_get_fd() {
+    pthread_mutex_lock(&event_list_mutex_);
+    if(event_fd_ < 0) {
+        event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+    int fd = event_fd_;
+    pthread_mutex_unlock(&event_list_mutex_);
+
+    return fd >= 0 ? fd : SDK_ERROR;
+}
+
+int smartwin_devices::event_drain(std::vector<smartwin_event>& events) {
+    if(event_fd_ < 0) {
+        return 0;
+    }
+
+    // 先清计数再取队列, 之后到达的事件会重新置位eventfd, 不会丢失唤醒
+    uint64_t cnt = 0;
+    if(read(event_fd_, &cnt, sizeof(cnt)) < 0) {
+        cnt = 0;
+    }
+
+    // 事件队列是副本, 输入延迟在从按键/触摸缓存取出时统计, 这里不重复记录
+    pthread_mutex_lock(&event_list_mutex_);
+    int n = event_list.size();
+    events.insert(events.end(), event_list.begin(), event_list.end());
+    event_list.clear();
+    pthread_mutex_unlock(&event_list_mutex_);
+
+    return n;
+}
+
+int smartwin_devices::drain_events(smartwin_event* events, int max) {
+    if(events == nullptr || max <= 0) {
+        return 0;
+    }
+
+    // 寻卡结果最多一条, 先取出再与按键/触摸按时间合并
+    smartwin_event card;
+    bool has_card = false;
+    std::vector<uint8_t> card_buf;
+    pthread_mutex_lock(&search_card_list_mutex_);
+    if(!search_card_list.empty()) {
+        card_buf.swap(search_card_list.back());
+        search_card_list.clear();
+        has_card = smartwin_decode_search_card(card_buf, card);
+        card.timestamp_us = search_card_detect_us_;
+        card.rx_start_us = search_card_rx_start_us_;
+    }
+    pthread_mutex_unlock(&search_card_list_mutex_);
+
+    int n = 0;
+    int touches = 0;
+    smartwin_key_event key;
+    smartwin_touch_point pt;
+    while(n < max) {
+        bool has_key = key_ring_.peek(key);
+        bool has_touch = touch_ring_.peek(pt);
+        if(!has_key && !has_touch && !has_card) {
+            break;
+        }
+
+        smartwin_event& ev = events[n++];
+        if(has_card && (!has_key || card.timestamp_us <= key.timestamp_us)
+            && (!has_touch || card.timestamp_us <= pt.timestamp_us)) {
+            ev = card;
+            has_card = false;
+        }
+        else if(has_key && (!has_touch || key.timestamp_us <= pt.timestamp_us)) {
+            key_ring_.pop(key);
+            record_input_latency(SW_LATENCY_KEY, key.rx_start_us, key.timestamp_us);
+            ev.type = SW_EVENT_KEY;
+            ev.timestamp_us = key.timestamp_us;
+            ev.rx_start_us = key.rx_start_us;
+            ev.key.code = key.code;
+        }
+        else {
+            touch_ring_.pop(pt);
+            touch_last_ = pt;
+            touches++;
+            record_input_latency(SW_LATENCY_TOUCH, pt.rx_start_us, pt.timestamp_us);
+            ev.type = SW_EVENT_TOUCH;
+            ev.timestamp_us = pt.timestamp_us;
+            ev.rx_start_us = pt.rx_start_us;
+            ev.touch.x = pt.x;
+            ev.touch.y = pt.y;
+            ev.touch.action = pt.action;
+        }
+    }
+    touch_rate_->note_drain(smartwin_now_us(), touches, n < max);
+
+    if(n < max && touch_release(pt)) {
+        smartwin_event& ev = events[n++];
+        ev.type = SW_EVENT_TOUCH;
+        ev.timestamp_us = pt.timestamp_us;
+        ev.rx_start_us = 0;
+        ev.touch.x = pt.x;
+        ev.touch.y = pt.y;
+        ev.touch.action = SW_TOUCH_UP;
+    }
+
+    // 数组已满, 寻卡结果放回缓存(期间到达的新结果优先)
+    if(has_card) {
+        pthread_mutex_lock(&search_card_list_mutex_);
+        if(search_card_list.empty()) {
+            search_card_list.push(card_buf);
+        }
+        pthread_mutex_unlock(&search_card_list_mutex_);
+    }
+    return n;
 }
 
 int smartwin_devices::send_request_cmd(uint8_t cmd, std::vector<uint8_t> params){
-    std::vector<uint8_t> buf;
+    return send_request(request_frame(cmd, params), REQUEST_APP);
+}
+
+int smartwin_devices::send_request(const std::vector<uint8_t>& frame, uint8_t owner) {
+    uint8_t cmd = frame[0];
+    if(owner == REQUEST_NONE) {
+        return _comm->sendcmd(frame);
+    }
+
+    // 先登记再发送, 应答可能在sendcmd返回之前到达; 登记后在位检测不再发送
+    uint64_t hold_us = (uint64_t)smartwin_presence::RESPONSE_TIMEOUT_MS * 1000;
+    if(owner == REQUEST_APP) {
+        smartwin_timeout_info info;
+        timeout_policy_->get_info(cmd, info);
+        hold_us = ((uint64_t)std::max(info.config.max_ms, (uint32_t)recv_timeout) + 1000) * 1000;
+    }
+    uint64_t now = smartwin_now_us();
+
+    pthread_mutex_lock(&recv_list_mutex_);
+    uint64_t seq = ++request_seq_;
+    pending_.push_back({seq, cmd, owner, now, now + hold_us});
+    pthread_mutex_unlock(&recv_list_mutex_);
+
+    // 在位检测在接收线程或process()中发送, 不能覆盖调用线程正在等待的请求
+    if(owner == REQUEST_APP) {
+        current_request_.seq = seq;
+        current_request_.cmd = cmd;
+        current_request_.send_us = now;
+        current_request_.link_epoch = link_epoch_.load();
+        current_request_.port_epoch = port_epoch_.load();
+        current_request_.frame.clear();
+        if(link_replay_ && replay_cmd_[cmd]) {
+            current_request_.frame = frame;
+        }
+        current_request_.send_ret = SDK_OK;
+    }
+    int ret = _comm->sendcmd(frame);
+    if(owner == REQUEST_APP && current_request_.seq == seq) {
+        current_request_.send_ret = ret;
+    }
+    return ret;
+}
 
-    buf.push_back(cmd);
-    buf.push_back(0x2F);
-    buf.push_back(params.size()/256);
-    buf.push_back(params.size()%256);
+void smartwin_devices::hold_request(uint64_t seq, int timeout_ms) {
+    // 等待者按自己的超时等待(扫码, 密码输入可长于命令的超时上限), 等待期间登记不能被清理
+    uint64_t deadline = smartwin_now_us() + ((uint64_t)std::max(timeout_ms, 0) + 1000) * 1000;
+    pthread_mutex_lock(&recv_list_mutex_);
+    for(pending_request& p : pending_) {
+        if(p.seq == seq) {
+            p.deadline_us = std::max(p.deadline_us, deadline);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&recv_list_mutex_);
+}
+
+void smartwin_devices::end_request(uint64_t seq, uint8_t cmd, int discard_ms) {
+    pthread_mutex_lock(&recv_list_mutex_);
+    if(discard_ms > 0) {
+        // 超时的请求: 刚到的应答直接丢弃, 否则标记丢弃下一个迟到的应答,
+        // 避免被下一次同命令字的请求取走
+        bool arrived = false;
+        for(auto it = recv_list.begin(); it != recv_list.end(); ++it) {
+            const pending_request* owner = response_owner(*it);
+            if(owner != nullptr && owner->seq == seq) {
+                recv_list.erase(it);
+                arrived = true;
+                break;
+            }
+        }
+        if(!arrived) {
+            mark_discard(cmd, cmd, discard_ms);
+        }
+    }
+    for(auto it = pending_.begin(); it != pending_.end(); ++it) {
+        if(it->seq == seq) {
+            pending_.erase(it);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&recv_list_mutex_);
+}
 
-    for(auto param : params) {
-        buf.push_back(param);
+const smartwin_devices::pending_request* smartwin_devices::response_owner(const response_frame& frame) {
+    // 调用者持有recv_list_mutex_
+    uint64_t now = smartwin_now_us();
+    for(auto it = pending_.begin(); it != pending_.end(); ) {
+        if(it->deadline_us <= now) {
+            it = pending_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if(frame.buf.size() < 4 || frame.buf[1] != 0x4F) {
+        return nullptr;
+    }
+    for(const pending_request& p : pending_) {
+        if(p.cmd == frame.buf[0] && p.send_us <= frame.rx_us) {
+            return &p;
+        }
     }
-    return _comm->sendcmd(buf);
+    return nullptr;
+}
+
+bool smartwin_devices::presence_response(const std::vector<uint8_t>& buf) {
+    bool mine = false;
+    response_frame frame = {buf, _comm->frame_end_us()};
+
+    pthread_mutex_lock(&recv_list_mutex_);
+    const pending_request* owner = response_owner(frame);
+    if(owner != nullptr && owner->owner == REQUEST_PRESENCE) {
+        uint64_t seq = owner->seq;
+        for(auto it = pending_.begin(); it != pending_.end(); ++it) {
+            if(it->seq == seq) {
+                pending_.erase(it);
+                break;
+            }
+        }
+        mine = true;
+    }
+    pthread_mutex_unlock(&recv_list_mutex_);
+    return mine;
+}
+
+bool smartwin_devices::app_request_pending() {
+    bool pending = false;
+
+    pthread_mutex_lock(&recv_list_mutex_);
+    for(const pending_request& p : pending_) {
+        if(p.owner == REQUEST_APP && p.deadline_us > smartwin_now_us()) {
+            pending = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&recv_list_mutex_);
+    return pending;
 }
 
 int smartwin_devices::recv_from_list(int8_t cmd, std::vector<uint8_t> &buf){
+    int timeout_ms = timeout_policy_->get_timeout((uint8_t)cmd);
+    uint64_t start = smartwin_now_us();
+
+    // 等待期间(无线程模式下process()中的回调)可能发出别的请求, 先取出本次的请求帧;
+    // 往返时间从发送前开始计算
+    std::vector<uint8_t> request;
+    uint64_t send_us = start;
+    if(current_request_.seq != 0 && current_request_.cmd == (uint8_t)cmd) {
+        request.swap(current_request_.frame);
+        send_us = current_request_.send_us;
+    }
+
+    int ret = recv_from_list((uint8_t)cmd, buf, timeout_ms, nullptr);
+    if(ret == SDK_TIMEOUT) {
+        timeout_policy_->record_timeout((uint8_t)cmd, timeout_ms);
+    }
+    else if(ret == SDK_LINK_LOST || ret == SDK_LINK_DOWN) {
+        // 断开不反映固件处理时间, 不计入超时学习
+        // 学习到的超时可能远小于重连时间, 重发最多等到该命令的超时上限
+        smartwin_timeout_info info;
+        timeout_policy_->get_info((uint8_t)cmd, info);
+        int left = (int)std::max(info.config.max_ms, (uint32_t)timeout_ms)
+            - (int)((smartwin_now_us() - start) / 1000);
+        if(link_replay_ && replay_cmd_[(uint8_t)cmd] && left > 0 && !request.empty()) {
+            int r = replay_request(request, buf, left);
+            if(r != SDK_LINK_LOST && r != SDK_LINK_DOWN && r != SDK_TIMEOUT) {
+                ret = r;
+            }
+        }
+    }
+    else {
+        timeout_policy_->record((uint8_t)cmd, (uint32_t)(smartwin_now_us() - send_us));
+    }
+    return ret;
+}
+
+int smartwin_devices::replay_request(const std::vector<uint8_t>& request, std::vector<uint8_t>& buf, int timeout_ms) {
+    // 在重发预算内等待链路恢复, 重发后的应答仍按该命令当前的超时等待
+    uint8_t cmd = request[0];
+    uint64_t deadline = smartwin_now_ms() + timeout_ms;
+    while(!link_is_up()) {
+        if(smartwin_now_ms() >= deadline) {
+            return SDK_LINK_LOST;
+        }
+        recv_wait(1);
+    }
+
+    int left = std::min((int)(deadline - smartwin_now_ms()), timeout_policy_->get_timeout(cmd));
+    if(left <= 0) {
+        return SDK_TIMEOUT;
+    }
+    printf("replay cmd 0x%02x after link recovery\n", cmd);
+    send_request(request, REQUEST_APP);
+    return recv_from_list(cmd, buf, left, nullptr);
+}
+
+int smartwin_devices::recv_from_list(uint8_t cmd, std::vector<uint8_t> &buf, int timeout_ms, smartwin_cancel_token* token){
+    return recv_list_wait(cmd, buf, timeout_ms, token);
+}
+
+int smartwin_devices::recv_list_wait(uint8_t cmd, std::vector<uint8_t> &buf, int timeout_ms, smartwin_cancel_token* token){
+    // 没有经send_request_cmd发出的请求时, 取该命令字最早的应答
+    request_record req = {0, cmd, 0, link_epoch_.load(), port_epoch_.load(), SDK_OK, {}};
+    if(current_request_.seq != 0 && current_request_.cmd == cmd) {
+        req.seq = current_request_.seq;
+        req.send_us = current_request_.send_us;
+        req.link_epoch = current_request_.link_epoch;
+        req.port_epoch = current_request_.port_epoch;
+        req.send_ret = current_request_.send_ret;
+        current_request_.seq = 0;
+    }
+
+    // 帧没有发出(发送队列满, 或发送失败已按断开处理), 不会有应答
+    int ret;
+    if(req.send_ret == SDK_LINK_LOST) {
+        ret = SDK_LINK_LOST;
+    }
+    else if(req.send_ret < 0) {
+        ret = SDK_ERROR;
+    }
+    else {
+        if(req.seq != 0) {
+            hold_request(req.seq, timeout_ms);
+        }
+        ret = recv_response(req, buf, timeout_ms, token);
+    }
+    if(req.seq != 0) {
+        int discard_ms = 0;
+        if(ret == SDK_TIMEOUT) {
+            smartwin_timeout_info info;
+            timeout_policy_->get_info(cmd, info);
+            discard_ms = (int)std::max(info.config.max_ms, (uint32_t)timeout_ms);
+        }
+        end_request(req.seq, cmd, discard_ms);
+    }
+    return ret;
+}
+
+int smartwin_devices::recv_response(const request_record& req, std::vector<uint8_t>& buf, int timeout_ms, smartwin_cancel_token* token) {
     int ret = SDK_TIMEOUT;
-    int timeout = recv_timeout;
+    int timeout = timeout_ms;
     while (timeout > 0)
     {
-        if (recv_list.size() > 0)
-        {
-            for(auto recv_buf : recv_list) {
-                if (recv_buf[0] == cmd && recv_buf[1] == 0x4F)
-                {
-                    std::vector<uint8_t> tmp = recv_buf;
+        if (token != nullptr && token->is_cancelled()) {
+            printf("recv canceled: %d ms\n", timeout_ms - timeout);
+            return SDK_ESC;
+        }
 
-                    pthread_mutex_lock(&recv_list_mutex_);
-                    recv_list.erase(recv_list.begin());
-                    pthread_mutex_unlock(&recv_list_mutex_);
+        // 串口断开, 已发出的命令随旧连接丢失
+        if (!port_up_.load() || port_epoch_.load() != req.port_epoch) {
+            printf("recv link lost: %d ms\n", timeout_ms - timeout);
+            return SDK_LINK_LOST;
+        }
 
-                    int ln = tmp[2] * 256 + tmp[3];
-                    if(ln >= 4) {
+        // 安全芯片掉电或复位, 已发出的命令不会再有应答
+        if (!link_up_.load() || link_epoch_.load() != req.link_epoch) {
+            printf("recv link down: %d ms\n", timeout_ms - timeout);
+            return SDK_LINK_DOWN;
+        }
 
-                        ret = tmp[4];
-                        ret = (ret<<8) + tmp[5];
-                        ret = (ret<<8) + tmp[6];
-                        ret = (ret<<8) + tmp[7];
+        // 其他请求的应答留在队列中; 不属于任何请求的应答是之前超时或取消的命令迟到的应答, 直接丢弃
+        bool found = false;
+        std::vector<uint8_t> tmp;
+        pthread_mutex_lock(&recv_list_mutex_);
+        for (auto it = recv_list.begin(); it != recv_list.end(); ) {
+            const pending_request* owner = response_owner(*it);
+            bool owned = owner != nullptr;
+            bool mine = req.seq != 0 ? (owned && owner->seq == req.seq)
+                : (it->buf[0] == req.cmd && it->buf[1] == 0x4F);
+            if (mine) {
+                tmp.swap(it->buf);
+                recv_list.erase(it);
+                found = true;
+                break;
+            }
+            if (!owned) {
+#ifdef SERIAL_DEBUG_INFO
+                printf("%s\n", _comm->printBuf("drop stale response: ", it->buf).c_str());
+#endif
+                it = recv_list.erase(it);
+                continue;
+            }
+            ++it;
+        }
+        pthread_mutex_unlock(&recv_list_mutex_);
 
-                        if(ret == 0) {
-                            buf = std::vector<uint8_t>(tmp.begin() + 8, tmp.begin() + 8 + ln - 4);
-                        }
-                    }
+        if (found)
+        {
+            int ln = tmp[2] * 256 + tmp[3];
+            if(ln >= 4) {
 
-                    printf("recv costed time: %d ms\n", recv_timeout - timeout);
+                ret = tmp[4];
+                ret = (ret<<8) + tmp[5];
+                ret = (ret<<8) + tmp[6];
+                ret = (ret<<8) + tmp[7];
 
-                    return ret; 
-                }
-                else {
-                    pthread_mutex_lock(&recv_list_mutex_);
-                    recv_list.erase(recv_list.begin());
-                    pthread_mutex_unlock(&recv_list_mutex_);
+                if(ret == 0) {
+                    buf = std::vector<uint8_t>(tmp.begin() + 8, tmp.begin() + 8 + ln - 4);
                 }
             }
+
+            printf("recv costed time: %d ms\n", timeout_ms - timeout);
+
+            return ret; 
         }
         
-        usleep(1000);
+        recv_wait(1);
         timeout--;
     }
 
-    printf("Err. recv timeout: %d ms\n", recv_timeout - timeout);
+    printf("Err. recv timeout: %d ms\n", timeout_ms - timeout);
     
     return ret;
 }
 
+void smartwin_devices::discard_late_response(uint8_t cmd, uint8_t until_cmd, int timeout_ms) {
+    pthread_mutex_lock(&recv_list_mutex_);
+    mark_discard(cmd, until_cmd, timeout_ms);
+    pthread_mutex_unlock(&recv_list_mutex_);
+}
+
+void smartwin_devices::mark_discard(uint8_t cmd, uint8_t until_cmd, int timeout_ms) {
+    // 调用者持有recv_list_mutex_
+    discard_entry& e = discard_table_[cmd];
+    if(!e.active) {
+        discard_active_++;
+    }
+    e.active = true;
+    e.until_cmd = until_cmd;
+    e.deadline_ms = smartwin_now_ms() + timeout_ms;
+}
+
+bool smartwin_devices::discard_frame(const std::vector<uint8_t>& buf) {
+    if(discard_active_ == 0) {
+        return false;
+    }
+
+    bool drop = false;
+    uint8_t cmd = buf[0];
+    uint64_t now = smartwin_now_ms();
+
+    pthread_mutex_lock(&recv_list_mutex_);
+    discard_entry& e = discard_table_[cmd];
+    if(e.active && now < e.deadline_ms) {
+        drop = true;
+    }
+
+    // 链路按顺序应答, 收到关闭命令的应答说明之前的迟到应答不会再来
+    for(int i = 0; i < 256 && discard_active_ > 0; i++) {
+        discard_entry& d = discard_table_[i];
+        if(d.active && (d.until_cmd == cmd || now >= d.deadline_ms)) {
+            d.active = false;
+            discard_active_--;
+        }
+    }
+    pthread_mutex_unlock(&recv_list_mutex_);
+
+    if(drop) {
+        printf("%s\n", _comm->printBuf("discard late response: ", (uint8_t*)buf.data(), buf.size()).c_str());
+    }
+    return drop;
+}
+
+void smartwin_devices::cancel_abort(uint8_t cmd, uint8_t close_cmd, int timeout_ms) {
+    // 丢弃原命令迟到的应答和关闭命令的应答, 不等待关闭结果, 调用者立即返回
+    discard_late_response(cmd, close_cmd, timeout_ms);
+    discard_late_response(close_cmd, close_cmd, timeout_ms);
+    send_request(request_frame(close_cmd, {}), REQUEST_NONE);
+}
+
 std::vector<uint8_t> smartwin_devices::lvar_to_vector(std::vector<uint8_t> buf) {
     if (buf.size() < 1)
     {
@@ -370,9 +1244,7 @@ int smartwin_devices::get_enter_boot_state(uint8_t type, uint32_t& state) {
 }       
 
 int smartwin_devices::keyboard_open() {
-    pthread_mutex_lock(&keyinput_list_mutex_);
-    keyinput_list.clear();
-    pthread_mutex_unlock(&keyinput_list_mutex_);
+    key_ring_.clear();
 
     send_request_cmd(CMD_OPEN_KEYBOARD, {});
 
@@ -390,9 +1262,7 @@ int smartwin_devices::keyboard_close() {
 }
 
 int smartwin_devices::keyboard_clear_cache() {
-    pthread_mutex_lock(&keyinput_list_mutex_);
-    keyinput_list.clear();
-    pthread_mutex_unlock(&keyinput_list_mutex_);
+    key_ring_.clear();
     
     send_request_cmd(CMD_CLEAR_KEYBOARD_CACHE, {});
 
@@ -401,26 +1271,77 @@ int smartwin_devices::keyboard_clear_cache() {
     return ret;
 }
 
+void smartwin_devices::push_key_event(const std::vector<uint8_t>& buf) {
+    if(buf.size() < 8) {
+        return;
+    }
+
+    smartwin_key_event ev;
+    ev.code = buf[7];
+    ev.rx_start_us = _comm->frame_start_us();
+    ev.timestamp_us = _comm->frame_end_us();
+    key_pushed_++;
+    if(!key_ring_.push(ev)) {
+        key_dropped_++;
+        printf("Err. key ring full, drop key: 0x%02X, dropped: %llu\n", ev.code, (unsigned long long)key_dropped_.load());
+        return;
+    }
+    uint32_t depth = key_ring_.size();
+    if(depth > key_max_depth_.load(std::memory_order_relaxed)) {
+        key_max_depth_.store(depth, std::memory_order_relaxed);
+    }
+
+    // 仅在有线程等待时才加锁唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(key_waiters_.load() > 0) {
+        pthread_mutex_lock(&key_wait_mutex_);
+        pthread_cond_signal(&key_wait_cond_);
+        pthread_mutex_unlock(&key_wait_mutex_);
+    }
+}
+
 int smartwin_devices::keyboard_get_input(uint8_t& key) {
-    int ret = SDK_OK;
+    return keyboard_get_input(key, 0, nullptr);
+}
 
-    if(keyinput_list.size() > 0) {
-        std::vector<uint8_t> buf = keyinput_list[0];
+int smartwin_devices::keyboard_get_input(uint8_t& key, uint32_t timeout_ms, uint64_t* timestamp_us) {
+    smartwin_key_event ev;
+    uint64_t deadline = smartwin_now_ms() + timeout_ms;
 
-        pthread_mutex_lock(&keyinput_list_mutex_);
-        keyinput_list.erase(keyinput_list.begin());
-        pthread_mutex_unlock(&keyinput_list_mutex_);
+    while(!key_ring_.pop(ev)) {
+        uint64_t now = smartwin_now_ms();
+        if(now >= deadline) {
+            return timeout_ms > 0 ? SDK_TIMEOUT : SDK_ERROR;
+        }
 
-        uint32_t key_tmp = buf[4];
-        key_tmp = (key_tmp<<8) + buf[5];
-        key_tmp = (key_tmp<<8) + buf[6];
-        key_tmp = (key_tmp<<8) + buf[7];
-        key = (uint8_t)key_tmp;
+        if(threadless_mode_) {
+            // 无接收线程, 由等待者自己驱动收包
+            recv_wait((int)(deadline - now));
+            continue;
+        }
 
-    } else {
-        ret = SDK_ERROR;
+        pthread_mutex_lock(&key_wait_mutex_);
+        key_waiters_++;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(key_ring_.empty()) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            uint64_t ns = (uint64_t)ts.tv_nsec + (deadline - now) * 1000000ULL;
+            ts.tv_sec += ns / 1000000000ULL;
+            ts.tv_nsec = ns % 1000000000ULL;
+            pthread_cond_timedwait(&key_wait_cond_, &key_wait_mutex_, &ts);
+        }
+        key_waiters_--;
+        pthread_mutex_unlock(&key_wait_mutex_);
     }
-    return ret;
+
+    record_input_latency(SW_LATENCY_KEY, ev.rx_start_us, ev.timestamp_us);
+
+    key = ev.code;
+    if(timestamp_us != nullptr) {
+        *timestamp_us = ev.timestamp_us;
+    }
+    return SDK_OK;
 }
 
 int smartwin_devices::keyboard_set_sound(uint8_t sound) {
@@ -446,9 +1367,9 @@ int smartwin_devices::keyboard_set_backlight(uint8_t backlight) {
 #define SDK_TP_REPORT_YES  (0x00)            /**< 主动上报 */
 
 int smartwin_devices::tp_open() {
-    pthread_mutex_lock(&tpinput_list_mutex_);
-    tpinput_list.clear();
-    pthread_mutex_unlock(&tpinput_list_mutex_);
+    touch_ring_.clear();
+    touch_last_.action = SW_TOUCH_UP;
+    touch_last_us_ = 0;
 
     send_request_cmd(CMD_OPEN_TP, {SDK_TP_REPORT_YES});
 
@@ -474,45 +1395,108 @@ int smartwin_devices::tp_check_support() {
     return ret;
 }
 
-int smartwin_devices::tp_get_touch_coordinate(uint32_t &x, uint32_t &y) {
-    // send_request_cmd(CMD_GET_TOUCH_COORDINATE, {});
+void smartwin_devices::push_touch_point(const std::vector<uint8_t>& buf) {
+    if(buf.size() < 8) {
+        return;
+    }
 
-    // std::vector<uint8_t> buf;
-    // int ret = recv_from_list  (CMD_GET_TOUCH_COORDINATE, buf);
-    // if(ret == SDK_OK) {
-    //     x = buf[0] * 256 * 256 * 256 + buf[1] * 256 * 256 + buf[2] * 256 + buf[3];
-    //     y = buf[4] * 256 * 256 * 256 + buf[5] * 256 * 256 + buf[6] * 256 + buf[7];
-    // }
+    smartwin_event ev;
+    if(!smartwin_decode_touch(buf, ev)) {
+        return;
+    }
 
-    int ret = SDK_ERROR;
-    if(tpinput_list.size() > 0) {
-        std::vector<uint8_t> buf = tpinput_list[tpinput_list.size() - 1];
+    smartwin_touch_point pt;
+    pt.x = ev.touch.x;
+    pt.y = ev.touch.y;
+    pt.rx_start_us = _comm->frame_start_us();
+    pt.timestamp_us = _comm->frame_end_us();
 
-        pthread_mutex_lock(&tpinput_list_mutex_);
-        tpinput_list.clear();
-        pthread_mutex_unlock(&tpinput_list_mutex_);
+    // 固件不上报触摸动作, 按与上一点的间隔判断按下
+    uint64_t last = touch_last_us_.load();
+    if(last == 0 || pt.timestamp_us - last > (uint64_t)touch_gap_ms_ * 1000) {
+        pt.action = SW_TOUCH_DOWN;
+    }
+    else {
+        pt.action = SW_TOUCH_MOVE;
+    }
+    touch_last_us_ = pt.timestamp_us;
+    touch_push_action_ = pt.action;
 
-        x = buf[4] * 256 + buf[5];
-        y = buf[6] * 256 + buf[7];
+    touch_pushed_++;
+    touch_rate_->note_point(pt.timestamp_us);
+    if(!touch_ring_.push(pt)) {
+        touch_dropped_++;
+        printf("Err. touch ring full, drop point, dropped: %llu\n", (unsigned long long)touch_dropped_.load());
+        return;
+    }
+    uint32_t depth = touch_ring_.size();
+    if(depth > touch_max_depth_.load(std::memory_order_relaxed)) {
+        touch_max_depth_.store(depth, std::memory_order_relaxed);
+    }
+}
 
-        y = 239 - y;        //将触摸原点从左下角调整为左上角
+int smartwin_devices::tp_drain_touch_events(smartwin_touch_point* points, int max) {
+    if(points == nullptr || max <= 0) {
+        return 0;
+    }
 
-        if(y < 0) {
-            y = 0;
-        }
-        if(y > 239) {
-            y = 239;
-        }
-        if(x < 0) {
-            x = 0;
-        }
-        if(x > 319) {
-            x = 319;
-        }
-        ret = SDK_OK;
+    int n = 0;
+    while(n < max && touch_ring_.pop(points[n])) {
+        touch_last_ = points[n];
+        record_input_latency(SW_LATENCY_TOUCH, points[n].rx_start_us, points[n].timestamp_us);
+        n++;
     }
+    touch_rate_->note_drain(smartwin_now_us(), n, n < max);
 
-    return ret;
+    if(n < max && touch_release(points[n])) {
+        n++;
+    }
+    return n;
+}
+
+bool smartwin_devices::touch_release(smartwin_touch_point& pt) {
+    // 下位机只在触摸时上报, 超时未更新补一个抬起点
+    if(touch_last_.action == SW_TOUCH_UP
+        || smartwin_now_us() - touch_last_.timestamp_us <= (uint64_t)touch_gap_ms_ * 1000) {
+        return false;
+    }
+    touch_last_.action = SW_TOUCH_UP;
+    touch_last_.timestamp_us = smartwin_now_us();
+    touch_last_.rx_start_us = 0;
+    pt = touch_last_;
+    return true;
+}
+
+int smartwin_devices::tp_get_touch_coordinate(uint32_t &x, uint32_t &y) {
+    // 只取最新的点, 丢弃之前的点
+    smartwin_touch_point pt;
+    bool found = false;
+    while(touch_ring_.pop(pt)) {
+        touch_last_ = pt;
+        found = true;
+    }
+    touch_rate_->note_drain(smartwin_now_us(), found ? 1 : 0, true);
+    if(!found) {
+        return SDK_ERROR;
+    }
+    record_input_latency(SW_LATENCY_TOUCH, pt.rx_start_us, pt.timestamp_us);
+
+    x = pt.x;
+    y = pt.y;
+    return SDK_OK;
+}
+
+int smartwin_devices::tp_set_adaptive_rate(bool enable, uint32_t min_interval_ms, uint32_t idle_interval_ms) {
+    if(min_interval_ms == 0 || idle_interval_ms < min_interval_ms) {
+        return SDK_PARAMERR;
+    }
+    touch_rate_->enable(enable, min_interval_ms, idle_interval_ms);
+    return SDK_OK;
+}
+
+int smartwin_devices::get_touch_rate_stats(smartwin_touch_rate_stats& stats) {
+    touch_rate_->get_stats(stats);
+    return SDK_OK;
 }
 
 int smartwin_devices::tp_set_parameter(uint32_t start_x, uint32_t start_y, uint32_t end_x, uint32_t end_y, uint32_t interval) {
@@ -542,6 +1526,14 @@ int smartwin_devices::tp_set_parameter(uint32_t start_x, uint32_t start_y, uint3
 
     std::vector<uint8_t> buf;
     int ret = recv_from_list(CMD_SET_TOUCH_PARAMETER, buf);
+    if(ret == SDK_OK) {
+        touch_gap_ms_ = interval * 3 > 60 ? interval * 3 : 60;
+        tp_area_[0] = start_x;
+        tp_area_[1] = start_y;
+        tp_area_[2] = end_x;
+        tp_area_[3] = end_y;
+        touch_rate_->set_interval(interval);
+    }
     return ret;
 }
 
@@ -550,6 +1542,9 @@ int smartwin_devices::magnetic_stripe_card_open() {
 
     std::vector<uint8_t> buf;
     int ret = recv_from_list(CMD_OPEN_MAGNETIC_STRIPE_CARD, buf);
+    if(ret == SDK_OK) {
+        presence_->boost();
+    }
     return ret;
 }
 
@@ -643,6 +1638,9 @@ int smartwin_devices::ic_card_open(uint8_t card_type, uint8_t card_seat) {
 
     std::vector<uint8_t> buf;
     int ret = recv_from_list(CMD_OPEN_IC_CARD_MODULE, buf);
+    if(ret == SDK_OK) {
+        presence_->boost();
+    }
     return ret;
 }
 
@@ -667,17 +1665,27 @@ int smartwin_devices::ic_card_check_status(uint8_t card_type, uint8_t card_seat)
     icstatus_list.clear();
     pthread_mutex_unlock(&icstatus_list_mutex_);
 
-    send_request_cmd(CMD_CHECK_IC_STATUS, tmp);
-
-    int timeout = recv_timeout;
+    // 应答由分发器放入IC卡状态队列, 不进入应答队列; 登记请求使在位检测的同命令应答不会被当作本次结果
+    int timeout_ms = timeout_policy_->get_timeout(CMD_CHECK_IC_STATUS);
+    uint64_t start = smartwin_now_us();
+    send_request(request_frame(CMD_CHECK_IC_STATUS, tmp), REQUEST_APP);
+    uint64_t seq = current_request_.seq;
+    current_request_.seq = 0;
+    hold_request(seq, timeout_ms);
+    int timeout = timeout_ms;
     while(timeout > 0) {
-        if (icstatus_list.size() > 0) {
-            std::vector<uint8_t> buf = icstatus_list[icstatus_list.size() - 1];
-
-            pthread_mutex_lock(&icstatus_list_mutex_);
+        std::vector<uint8_t> buf;
+        pthread_mutex_lock(&icstatus_list_mutex_);
+        if (!icstatus_list.empty()) {
+            buf.swap(icstatus_list.back());
             icstatus_list.clear();
-            pthread_mutex_unlock(&icstatus_list_mutex_);
-            
+        }
+        pthread_mutex_unlock(&icstatus_list_mutex_);
+
+        if (buf.size() >= 8) {
+            timeout_policy_->record(CMD_CHECK_IC_STATUS, (uint32_t)(smartwin_now_us() - start));
+            end_request(seq, CMD_CHECK_IC_STATUS, 0);
+
             int status = buf[4];
             status = (status<<8) + buf[5];
             status = (status<<8) + buf[6];
@@ -685,11 +1693,13 @@ int smartwin_devices::ic_card_check_status(uint8_t card_type, uint8_t card_seat)
             return status;
         }
         else {
-            usleep(1000);
+            recv_wait(1);
             timeout--;
         }
     }
 
+    timeout_policy_->record_timeout(CMD_CHECK_IC_STATUS, timeout_ms);
+    end_request(seq, CMD_CHECK_IC_STATUS, 0);
     return SDK_TIMEOUT;
 }
 
@@ -838,9 +1848,110 @@ int smartwin_devices::mifare_card_operation(uint8_t operation_instruction, uint8
     return ret;
 }
 
-int smartwin_devices::search_card_start(uint8_t search_mode, uint32_t timeout_ms) {
+void smartwin_devices::push_search_card(const std::vector<uint8_t>& buf, uint8_t policy) {
+    std::function<void(int, uint8_t, uint8_t)> cb;
+    uint64_t detect_us = smartwin_now_us();
+
+    pthread_mutex_lock(&search_card_list_mutex_);
+    if(search_card_callback_) {
+        // 回调为一次性, 结果直接交给回调, 不进入缓存
+        cb = search_card_callback_;
+        search_card_callback_ = nullptr;
+    }
+    else {
+        if(policy == SW_POLICY_KEEP_LATEST) {
+            search_card_list.clear();
+        }
+        search_card_list.push(buf);
+        search_card_detect_us_ = detect_us;
+        search_card_rx_start_us_ = _comm->frame_start_us();
+        pthread_cond_broadcast(&search_card_cond_);
+    }
+    pthread_mutex_unlock(&search_card_list_mutex_);
+
+    if(cb) {
+        executor_->post(CMD_SEARCH_CARD_START, [this, cb, buf, detect_us]() {
+            uint8_t type = 0;
+            uint8_t key = 0;
+            int ret = parse_search_card(buf, type, key);
+            search_card_record_wake(detect_us);
+            cb(ret, type, key);
+        });
+    }
+}
+
+int smartwin_devices::parse_search_card(const std::vector<uint8_t>& buf, uint8_t &type, uint8_t &key) {
+    int ln = buf[2] * 256 + buf[3];
+    if(ln < 4) {
+        return SDK_ERROR;
+    }
+
+    int code = buf[4];
+    code = (code<<8) + buf[5];
+    code = (code<<8) + buf[6];
+    code = (code<<8) + buf[7];
+
+    if(ln >= 5) {
+        type = buf[8];
+    }
+    if((type & 0x01) == 0x01 && ln >= 6) {
+        key = buf[9];
+    }
+    return code;
+}
+
+void smartwin_devices::search_card_record_wake(uint64_t detect_us) {
+    search_card_latency_.record(detect_us, smartwin_now_us());
+}
+
+bool smartwin_devices::search_card_check_cancel() {
+    pthread_mutex_lock(&search_card_list_mutex_);
+    bool cancelled = search_card_token_ != nullptr && search_card_token_->is_cancelled();
+    bool stop = cancelled && !search_card_stopped_;
+    if(cancelled) {
+        search_card_token_ = nullptr;
+        search_card_callback_ = nullptr;
+        search_card_stopped_ = false;
+        search_card_list.clear();
+    }
+    pthread_mutex_unlock(&search_card_list_mutex_);
+
+    if(stop) {
+        cancel_abort(CMD_SEARCH_CARD_START, CMD_SEARCH_CARD_STOP, search_card_timeout_ + recv_timeout);
+    }
+    return cancelled;
+}
+
+void smartwin_devices::search_card_poll_cancel() {
+    // 接收线程中检查: 应用取消后不再查询状态时, 也要立即关闭射频寻卡;
+    // 令牌保留到应用下一次查询, 使其仍返回SDK_ESC
+    pthread_mutex_lock(&search_card_list_mutex_);
+    bool stop = search_card_token_ != nullptr && !search_card_stopped_
+        && search_card_token_->is_cancelled();
+    if(stop) {
+        search_card_stopped_ = true;
+        search_card_callback_ = nullptr;
+        search_card_list.clear();
+    }
+    pthread_mutex_unlock(&search_card_list_mutex_);
+
+    if(stop) {
+        cancel_abort(CMD_SEARCH_CARD_START, CMD_SEARCH_CARD_STOP, search_card_timeout_ + recv_timeout);
+    }
+}
+
+int smartwin_devices::search_card_start(uint8_t search_mode, uint32_t timeout_ms, smartwin_cancel_token* token) {
+    return search_card_send(search_mode, timeout_ms, token, nullptr);
+}
+
+int smartwin_devices::search_card_send(uint8_t search_mode, uint32_t timeout_ms, smartwin_cancel_token* token,
+        std::function<void(int, uint8_t, uint8_t)> callback) {
     pthread_mutex_lock(&search_card_list_mutex_);
     search_card_list.clear();
+    search_card_token_ = token;
+    search_card_timeout_ = timeout_ms;
+    search_card_stopped_ = false;
+    search_card_callback_ = callback;
     pthread_mutex_unlock(&search_card_list_mutex_);
 
     std::vector<uint8_t> tmp;
@@ -850,7 +1961,8 @@ int smartwin_devices::search_card_start(uint8_t search_mode, uint32_t timeout_ms
     tmp.push_back((uint8_t)((timeout_ms>>16)&0xFF));
     tmp.push_back((uint8_t)((timeout_ms>>8)&0xFF));
     tmp.push_back((uint8_t)(timeout_ms&0xFF));
-    send_request_cmd(CMD_SEARCH_CARD_START, tmp);
+    // 寻卡结果由接收线程分发到寻卡队列, 不进入应答队列
+    send_request(request_frame(CMD_SEARCH_CARD_START, tmp), REQUEST_NONE);
 
     // std::vector<uint8_t> buf;
     // int ret = recv_from_list(CMD_SEARCH_CARD_START, buf);
@@ -858,37 +1970,187 @@ int smartwin_devices::search_card_start(uint8_t search_mode, uint32_t timeout_ms
     return SDK_OK;
 }
 
+int smartwin_devices::search_card_start_async(uint8_t search_mode, uint32_t timeout_ms, std::function<void(int, uint8_t, uint8_t)> callback) {
+    return search_card_send(search_mode, timeout_ms, nullptr, callback);
+}
+
 int smartwin_devices::search_card_get_status(uint8_t &type, uint8_t &key) {
-    int ret = SDK_OK;
+    if(search_card_check_cancel()) {
+        return SDK_ESC;
+    }
 
-    if(search_card_list.size() > 0) {
-        std::vector<uint8_t> buf = search_card_list[search_card_list.size() - 1];
+    pthread_mutex_lock(&search_card_list_mutex_);
+    if(search_card_list.empty()) {
+        pthread_mutex_unlock(&search_card_list_mutex_);
+        return SDK_ERROR;
+    }
+    std::vector<uint8_t> buf = search_card_list.back();
+    search_card_list.clear();
+    pthread_mutex_unlock(&search_card_list_mutex_);
 
-        pthread_mutex_lock(&search_card_list_mutex_);
-        search_card_list.clear();
+    return parse_search_card(buf, type, key);
+}
+
+int smartwin_devices::search_card_wait(uint32_t timeout_ms, uint8_t &type, uint8_t &key) {
+    uint64_t deadline = smartwin_now_ms() + timeout_ms;
+
+    pthread_mutex_lock(&search_card_list_mutex_);
+    while(search_card_list.empty()) {
+        bool has_token = search_card_token_ != nullptr;
         pthread_mutex_unlock(&search_card_list_mutex_);
 
-        int ln = buf[2] * 256 + buf[3];
-        if(ln >= 4) {
-            int code = buf[4];
-            code = (code<<8) + buf[5];
-            code = (code<<8) + buf[6];
-            code = (code<<8) + buf[7];
+        if(search_card_check_cancel()) {
+            return SDK_ESC;
+        }
 
-            type = buf[8];
-            if((type & 0x01) == 0x01 && ln >= 6) {
-                key = buf[9];
-            }
+        uint64_t now = smartwin_now_ms();
+        if(now >= deadline) {
+            return SDK_TIMEOUT;
+        }
 
-            ret = code;
+        // 取消令牌无法唤醒条件变量, 有令牌时分段等待
+        uint64_t wait_ms = deadline - now;
+        if(has_token && wait_ms > 20) {
+            wait_ms = 20;
+        }
+
+        if(threadless_mode_) {
+            recv_wait((int)wait_ms);
+            pthread_mutex_lock(&search_card_list_mutex_);
+            continue;
+        }
+
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t ns = (uint64_t)ts.tv_nsec + wait_ms * 1000000ULL;
+        ts.tv_sec += ns / 1000000000ULL;
+        ts.tv_nsec = ns % 1000000000ULL;
+
+        pthread_mutex_lock(&search_card_list_mutex_);
+        if(search_card_list.empty()) {
+            pthread_cond_timedwait(&search_card_cond_, &search_card_list_mutex_, &ts);
         }
-    } else {
-        ret = SDK_ERROR;
     }
-    return ret;
+    std::vector<uint8_t> buf = search_card_list.back();
+    search_card_list.clear();
+    uint64_t detect_us = search_card_detect_us_;
+    pthread_mutex_unlock(&search_card_list_mutex_);
+
+    search_card_record_wake(detect_us);
+    return parse_search_card(buf, type, key);
+}
+
+void smartwin_devices::record_input_latency(uint8_t source, uint64_t rx_start_us, uint64_t rx_end_us) {
+    uint64_t now = smartwin_now_us();
+    input_latency_[source][SW_LATENCY_WIRE].record(rx_start_us, rx_end_us);
+    input_latency_[source][SW_LATENCY_QUEUE].record(rx_end_us, now);
+    input_latency_[source][SW_LATENCY_TOTAL].record(rx_start_us, now);
+}
+
+int smartwin_devices::get_input_latency(uint8_t source, uint8_t stage, smartwin_latency_histogram& hist) {
+    if(source >= SW_LATENCY_SOURCE_COUNT || stage >= SW_LATENCY_STAGE_COUNT) {
+        return SDK_PARAMERR;
+    }
+    input_latency_[source][stage].snapshot(hist);
+    return SDK_OK;
+}
+
+void smartwin_devices::reset_input_latency() {
+    for(int i = 0; i < SW_LATENCY_SOURCE_COUNT; i++) {
+        for(int j = 0; j < SW_LATENCY_STAGE_COUNT; j++) {
+            input_latency_[i][j].reset();
+        }
+    }
+}
+
+int smartwin_devices::set_serial_timing(uint32_t turnaround_ms, uint32_t margin_pct) {
+    return _comm->set_timing(turnaround_ms, margin_pct);
+}
+
+int smartwin_devices::get_serial_timing(smartwin_serial_timing& timing) {
+    _comm->get_timing(timing);
+    return SDK_OK;
+}
+
+bool smartwin_devices::get_io_uring() {
+    return _comm->get_io_uring();
+}
+
+bool smartwin_devices::link_probe_ok() {
+    const int PROBE_COUNT = 8;
+    uint32_t ok, bad;
+    _comm->get_frame_stats(ok, bad);
+    uint32_t bad_before = bad;
+
+    for(int i = 0; i < PROBE_COUNT; i++) {
+        send_request_cmd(CMD_GET_DEVICE_MODEL, {});
+
+        // 波特率不匹配时设备无应答或应答乱码, 用短超时尽快失败
+        std::vector<uint8_t> buf;
+        if(recv_from_list(CMD_GET_DEVICE_MODEL, buf, 100, nullptr) != SDK_OK) {
+            return false;
+        }
+    }
+
+    _comm->get_frame_stats(ok, bad);
+    return bad == bad_before;
+}
+
+int smartwin_devices::link_probe_baudrate(const uint32_t* rates, int count, uint32_t& baudrate) {
+    if(rates == nullptr || count <= 0) {
+        return SDK_PARAMERR;
+    }
+
+    std::vector<uint32_t> good;
+    good.push_back(_comm->get_baudrate());
+    if(!link_probe_ok()) {
+        baudrate = good.back();
+        return SDK_ERROR;
+    }
+
+    // 设备波特率固定时只换主机侧会永久失步
+    for(int i = 0; autobaud_ && i < count; i++) {
+        if(rates[i] <= good.back()) {
+            continue;
+        }
+        if(_comm->set_baudrate(rates[i]) != SDK_OK) {
+            break;
+        }
+        if(!link_probe_ok()) {
+            printf("link probe %u baud failed, back to %u\n", rates[i], good.back());
+            _comm->set_baudrate(good.back());
+            break;
+        }
+        good.push_back(rates[i]);
+    }
+
+    uint32_t ok, bad;
+    _comm->get_frame_stats(ok, bad);
+    link_rate_->set_rates(good, ok, bad);
+    baudrate = good.back();
+    return SDK_OK;
+}
+
+int smartwin_devices::get_link_rate_stats(smartwin_link_rate_stats& stats) {
+    link_rate_->get_stats(stats);
+    if(stats.rate_count == 0) {
+        stats.baudrate = _comm->get_baudrate();
+    }
+    return SDK_OK;
+}
+
+int smartwin_devices::get_search_card_stats(smartwin_latency_histogram& hist) {
+    search_card_latency_.snapshot(hist);
+    return SDK_OK;
 }
 
 int smartwin_devices::search_card_stop() {
+    pthread_mutex_lock(&search_card_list_mutex_);
+    search_card_token_ = nullptr;
+    search_card_callback_ = nullptr;
+    search_card_stopped_ = false;
+    pthread_mutex_unlock(&search_card_list_mutex_);
+
     send_request_cmd(CMD_SEARCH_CARD_STOP, {});
 
     std::vector<uint8_t> buf;
@@ -913,7 +2175,7 @@ int smartwin_devices::scan_close() {
     return ret;
 }
 
-int smartwin_devices::scan_read_data(uint32_t timeout_ms, std::vector<uint8_t>& data) {
+int smartwin_devices::scan_read_data(uint32_t timeout_ms, std::vector<uint8_t>& data, smartwin_cancel_token* token) {
     std::vector<uint8_t> tmp;
     tmp.push_back((uint8_t)((timeout_ms>>24)&0xFF));
     tmp.push_back((uint8_t)((timeout_ms>>16)&0xFF));
@@ -921,8 +2183,12 @@ int smartwin_devices::scan_read_data(uint32_t timeout_ms, std::vector<uint8_t>&
     tmp.push_back((uint8_t)(timeout_ms&0xFF));
     send_request_cmd(CMD_READ_SCAN_DATA, tmp);
 
+    // 下位机在timeout_ms内等待扫码, 主机等待时间需覆盖该时长
     std::vector<uint8_t> buf;
-    int ret = recv_from_list(CMD_READ_SCAN_DATA, buf);
+    int ret = recv_from_list(CMD_READ_SCAN_DATA, buf, timeout_ms + recv_timeout, token);
+    if(ret == SDK_ESC) {
+        cancel_abort(CMD_READ_SCAN_DATA, CMD_SCAN_CLOSE, timeout_ms + recv_timeout);
+    }
     if(ret == SDK_OK) {
         data = llvar_to_vector(buf);
     }
@@ -1191,7 +2457,8 @@ int smartwin_devices::keypad_calculate_mac(uint32_t master_key_index, std::vecto
 }
 
 int smartwin_devices::keypad_input_online_pin(uint32_t master_key_index, std::vector<uint8_t> pin_length, uint8_t row_number, uint8_t column_number, 
-        std::vector<uint8_t> card_number, uint8_t encryption_mode, uint32_t wait_input_time, std::vector<uint8_t>& encrypted_pin) {
+        std::vector<uint8_t> card_number, uint8_t encryption_mode, uint32_t wait_input_time, std::vector<uint8_t>& encrypted_pin,
+        smartwin_cancel_token* token) {
     std::vector<uint8_t> tmp;
     tmp.push_back((uint8_t)((master_key_index>>24)&0xFF));
     tmp.push_back((uint8_t)((master_key_index>>16)&0xFF));
@@ -1230,7 +2497,10 @@ int smartwin_devices::keypad_input_online_pin(uint32_t master_key_index, std::ve
     send_request_cmd(CMD_KEYPAD_INPUT_ONLINE_PIN, tmp);   
 
     std::vector<uint8_t> buf;
-    int ret = recv_from_list(CMD_KEYPAD_INPUT_ONLINE_PIN, buf);
+    int ret = recv_from_list(CMD_KEYPAD_INPUT_ONLINE_PIN, buf, wait_input_time + recv_timeout, token);
+    if(ret == SDK_ESC) {
+        cancel_abort(CMD_KEYPAD_INPUT_ONLINE_PIN, CMD_KEYPAD_CLOSE_PASSWORD, wait_input_time + recv_timeout);
+    }
     if(ret == SDK_OK) {
         encrypted_pin = llvar_to_vector(buf);
     }
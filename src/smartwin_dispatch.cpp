@@ -0,0 +1,144 @@
+#include "smartwin_dispatch.h"
+#include "smartwin_cmd.h"
+#include "smartwin_time.h"
+
+namespace smartwin {
+
+static const smartwin_dispatch_entry default_entry = {
+    SW_FRAME_RESPONSE, SW_QUEUE_RESPONSE, SW_POLICY_KEEP_ALL, nullptr, nullptr
+};
+
+// 主动上报命令字
+static const struct {
+    uint8_t cmd;
+    smartwin_dispatch_entry entry;
+} builtin_entries[] = {
+    { CMD_READ_KEYBOARD_INPUT,  { SW_FRAME_EVENT, SW_QUEUE_KEY, SW_POLICY_KEEP_ALL, smartwin_decode_key, nullptr } },
+    { CMD_GET_TOUCH_COORDINATE, { SW_FRAME_EVENT, SW_QUEUE_TOUCH, SW_POLICY_KEEP_ALL, smartwin_decode_touch, nullptr } },
+    { CMD_SEARCH_CARD_START,    { SW_FRAME_EVENT, SW_QUEUE_SEARCH_CARD, SW_POLICY_KEEP_LATEST, smartwin_decode_search_card, nullptr } },
+    { CMD_CHECK_IC_STATUS,      { SW_FRAME_RESPONSE | SW_FRAME_EVENT, SW_QUEUE_IC_STATUS, SW_POLICY_KEEP_LATEST, smartwin_decode_ic_status, nullptr } },
+};
+
+static bool is_builtin(const smartwin_dispatch_entry* e) {
+    if(e == &default_entry) {
+        return true;
+    }
+    for(auto& b : builtin_entries) {
+        if(e == &b.entry) {
+            return true;
+        }
+    }
+    return false;
+}
+
+smartwin_dispatcher::smartwin_dispatcher() {
+    pthread_mutex_init(&retired_mutex_, NULL);
+
+    for(int i = 0; i < 256; i++) {
+        table_[i].store(&default_entry, std::memory_order_relaxed);
+    }
+    for(auto& b : builtin_entries) {
+        table_[b.cmd].store(&b.entry, std::memory_order_relaxed);
+    }
+}
+
+smartwin_dispatcher::~smartwin_dispatcher() {
+    for(int i = 0; i < 256; i++) {
+        const smartwin_dispatch_entry* e = table_[i].load();
+        if(!is_builtin(e)) {
+            delete e;
+        }
+    }
+    for(auto e : retired_) {
+        delete e;
+    }
+    pthread_mutex_destroy(&retired_mutex_);
+}
+
+void smartwin_dispatcher::set_queue(uint8_t queue, smartwin_queue_sink sink) {
+    if(queue < SW_QUEUE_COUNT) {
+        queues_[queue] = sink;
+    }
+}
+
+void smartwin_dispatcher::set_entry(uint8_t cmd, const smartwin_dispatch_entry& entry) {
+    const smartwin_dispatch_entry* e = new smartwin_dispatch_entry(entry);
+
+    // 旧表项可能正被接收线程使用, 延迟到析构时释放
+    pthread_mutex_lock(&retired_mutex_);
+    const smartwin_dispatch_entry* old = table_[cmd].exchange(e, std::memory_order_acq_rel);
+    if(!is_builtin(old)) {
+        retired_.push_back(old);
+    }
+    pthread_mutex_unlock(&retired_mutex_);
+}
+
+const smartwin_dispatch_entry& smartwin_dispatcher::get_entry(uint8_t cmd) const {
+    return *table_[cmd].load(std::memory_order_acquire);
+}
+
+const smartwin_dispatch_entry& smartwin_dispatcher::dispatch(const std::vector<uint8_t>& buf) {
+    // 非应答帧(0x4F)不查表, 按命令应答处理
+    const smartwin_dispatch_entry& e = (buf.size() >= 2 && buf[1] == 0x4F) ? get_entry(buf[0]) : default_entry;
+
+    if(e.handler) {
+        e.handler(buf);
+    }
+    else if(e.queue != SW_QUEUE_NONE && e.queue < SW_QUEUE_COUNT && queues_[e.queue]) {
+        queues_[e.queue](buf, e.policy);
+    }
+    return e;
+}
+
+static int32_t frame_code(const std::vector<uint8_t>& buf) {
+    return (int32_t)(((uint32_t)buf[4] << 24) | ((uint32_t)buf[5] << 16) | ((uint32_t)buf[6] << 8) | buf[7]);
+}
+
+bool smartwin_decode_key(const std::vector<uint8_t>& buf, smartwin_event& ev) {
+    if(buf.size() < 8) {
+        return false;
+    }
+    ev.type = SW_EVENT_KEY;
+    ev.timestamp_us = smartwin_now_us();
+    ev.key.code = (uint8_t)frame_code(buf);
+    return true;
+}
+
+bool smartwin_decode_touch(const std::vector<uint8_t>& buf, smartwin_event& ev) {
+    if(buf.size() < 8) {
+        return false;
+    }
+    int x = buf[4] * 256 + buf[5];
+    int y = 239 - (buf[6] * 256 + buf[7]);     //将触摸原点从左下角调整为左上角
+    ev.type = SW_EVENT_TOUCH;
+    ev.timestamp_us = smartwin_now_us();
+    ev.touch.x = (uint16_t)(x < 0 ? 0 : (x > 319 ? 319 : x));
+    ev.touch.y = (uint16_t)(y < 0 ? 0 : (y > 239 ? 239 : y));
+    ev.touch.action = SW_TOUCH_MOVE;
+    return true;
+}
+
+bool smartwin_decode_search_card(const std::vector<uint8_t>& buf, smartwin_event& ev) {
+    if(buf.size() < 8) {
+        return false;
+    }
+    int ln = buf[2] * 256 + buf[3];
+    ev.type = SW_EVENT_SEARCH_CARD;
+    ev.timestamp_us = smartwin_now_us();
+    ev.search_card.result = frame_code(buf);
+    ev.search_card.card_type = ln >= 5 ? buf[8] : 0;
+    ev.search_card.key = ((ev.search_card.card_type & 0x01) == 0x01 && ln >= 6) ? buf[9] : 0;
+    return true;
+}
+
+bool smartwin_decode_ic_status(const std::vector<uint8_t>& buf, smartwin_event& ev) {
+    if(buf.size() < 8) {
+        return false;
+    }
+    ev.type = SW_EVENT_IC_STATUS;
+    ev.timestamp_us = smartwin_now_us();
+    ev.ic.status = frame_code(buf);
+    return true;
+}
+
+}
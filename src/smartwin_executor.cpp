@@ -0,0 +1,166 @@
+#include "smartwin_executor.h"
+#include "smartwin_def.h"
+#include "smartwin_time.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace smartwin {
+
+smartwin_executor::smartwin_executor(int workers, size_t capacity) {
+    capacity_ = capacity;
+    memset(&stats_, 0, sizeof(stats_));
+
+    pthread_mutex_init(&mutex_, NULL);
+
+    int n = workers > 0 ? workers : 1;
+    for(int i = 0; i < n; i++) {
+        lane* l = new lane();
+        l->owner = this;
+        pthread_cond_init(&l->cond, NULL);
+        lanes_.push_back(l);
+    }
+
+    if(workers > 0) {
+        running_ = true;
+        for(auto l : lanes_) {
+            pthread_create(&l->thread, NULL, &smartwin_executor::worker_func, l);
+        }
+    }
+}
+
+smartwin_executor::~smartwin_executor() {
+    if(running_) {
+        pthread_mutex_lock(&mutex_);
+        running_ = false;
+        for(auto l : lanes_) {
+            pthread_cond_broadcast(&l->cond);
+        }
+        pthread_mutex_unlock(&mutex_);
+
+        for(auto l : lanes_) {
+            pthread_join(l->thread, NULL);
+        }
+    }
+
+    for(auto l : lanes_) {
+        pthread_cond_destroy(&l->cond);
+        delete l;
+    }
+    pthread_mutex_destroy(&mutex_);
+}
+
+void smartwin_executor::bind(uint32_t key, size_t lane) {
+    pthread_mutex_lock(&mutex_);
+    bindings_[key] = lane % lanes_.size();
+    pthread_mutex_unlock(&mutex_);
+}
+
+smartwin_executor::lane* smartwin_executor::lane_for(uint32_t key) {
+    // 调用者持有mutex_
+    auto it = bindings_.find(key);
+    if(it != bindings_.end()) {
+        return lanes_[it->second];
+    }
+    // 命令字多为偶数, 直接取模会集中到同一通道, 先做乘法哈希
+    uint32_t h = key * 2654435761u;
+    return lanes_[(h >> 16) % lanes_.size()];
+}
+
+int smartwin_executor::post(uint32_t key, std::function<void()> task) {
+    pthread_mutex_lock(&mutex_);
+
+    stats_.submitted++;
+    lane* l = lane_for(key);
+    if(l->tasks.size() >= capacity_) {
+        stats_.dropped++;
+        pthread_mutex_unlock(&mutex_);
+        printf("Err. executor lane full, drop callback key: 0x%02X\n", key);
+        return SDK_ERROR;
+    }
+
+    l->tasks.push_back(std::move(task));
+    depth_++;
+    if(depth_ > stats_.max_queue_depth) {
+        stats_.max_queue_depth = depth_;
+    }
+    pthread_cond_signal(&l->cond);
+
+    pthread_mutex_unlock(&mutex_);
+    return SDK_OK;
+}
+
+void smartwin_executor::execute(std::function<void()>& task) {
+    uint64_t start = smartwin_now_us();
+    task();
+    uint32_t cost = (uint32_t)(smartwin_now_us() - start);
+
+    pthread_mutex_lock(&mutex_);
+    stats_.executed++;
+    stats_.callback_time_total_us += cost;
+    if(cost > stats_.callback_time_max_us) {
+        stats_.callback_time_max_us = cost;
+    }
+    pthread_mutex_unlock(&mutex_);
+}
+
+int smartwin_executor::run_pending() {
+    // 回调内再次调用process()时不重入
+    if(running_ || in_run_pending_) {
+        return 0;
+    }
+    in_run_pending_ = true;
+
+    int cnt = 0;
+    for(lane* l : lanes_) {
+        while(true) {
+            pthread_mutex_lock(&mutex_);
+            if(l->tasks.empty()) {
+                pthread_mutex_unlock(&mutex_);
+                break;
+            }
+            std::function<void()> task = std::move(l->tasks.front());
+            l->tasks.pop_front();
+            depth_--;
+            pthread_mutex_unlock(&mutex_);
+
+            execute(task);
+            cnt++;
+        }
+    }
+
+    in_run_pending_ = false;
+    return cnt;
+}
+
+void* smartwin_executor::worker_func(void* arg) {
+    lane* l = (lane*)arg;
+    smartwin_executor* ex = l->owner;
+
+    pthread_mutex_lock(&ex->mutex_);
+    while(ex->running_) {
+        if(l->tasks.empty()) {
+            pthread_cond_wait(&l->cond, &ex->mutex_);
+            continue;
+        }
+        std::function<void()> task = std::move(l->tasks.front());
+        l->tasks.pop_front();
+        ex->depth_--;
+        pthread_mutex_unlock(&ex->mutex_);
+
+        ex->execute(task);
+
+        pthread_mutex_lock(&ex->mutex_);
+    }
+    pthread_mutex_unlock(&ex->mutex_);
+
+    return nullptr;
+}
+
+void smartwin_executor::get_stats(smartwin_executor_stats& stats) {
+    pthread_mutex_lock(&mutex_);
+    stats = stats_;
+    stats.queue_depth = depth_;
+    pthread_mutex_unlock(&mutex_);
+}
+
+}
@@ -0,0 +1,75 @@
+#include "smartwin_latency.h"
+#include <string.h>
+
+namespace smartwin {
+
+smartwin_latency_recorder::smartwin_latency_recorder() {
+    reset();
+}
+
+void smartwin_latency_recorder::record(uint64_t latency_us) {
+    uint32_t us = latency_us > 0xFFFFFFFFULL ? 0xFFFFFFFF : (uint32_t)latency_us;
+
+    int bucket = 0;
+    for(uint32_t v = us; v > 1 && bucket < SW_LATENCY_BUCKETS - 1; v >>= 1) {
+        bucket++;
+    }
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    total_us_.fetch_add(us, std::memory_order_relaxed);
+
+    uint32_t cur = min_us_.load(std::memory_order_relaxed);
+    while(us < cur && !min_us_.compare_exchange_weak(cur, us, std::memory_order_relaxed)) {
+    }
+    cur = max_us_.load(std::memory_order_relaxed);
+    while(us > cur && !max_us_.compare_exchange_weak(cur, us, std::memory_order_relaxed)) {
+    }
+}
+
+void smartwin_latency_recorder::snapshot(smartwin_latency_histogram& hist) const {
+    memset(&hist, 0, sizeof(hist));
+
+    uint32_t count = 0;
+    for(int i = 0; i < SW_LATENCY_BUCKETS; i++) {
+        hist.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        count += hist.buckets[i];
+    }
+    if(count == 0) {
+        return;
+    }
+
+    hist.count = count;
+    hist.min_us = min_us_.load(std::memory_order_relaxed);
+    hist.max_us = max_us_.load(std::memory_order_relaxed);
+    hist.total_us = total_us_.load(std::memory_order_relaxed);
+
+    // 百分位取所在桶的上限, 并且不超过实际最大值
+    uint32_t p50 = (count + 1) / 2;
+    uint32_t p99 = count - count / 100;
+    uint32_t seen = 0;
+    for(int i = 0; i < SW_LATENCY_BUCKETS; i++) {
+        uint32_t prev = seen;
+        seen += hist.buckets[i];
+        uint32_t upper = (2U << i) - 1;
+        if(upper > hist.max_us) {
+            upper = hist.max_us;
+        }
+        if(prev < p50 && seen >= p50) {
+            hist.p50_us = upper;
+        }
+        if(prev < p99 && seen >= p99) {
+            hist.p99_us = upper;
+            break;
+        }
+    }
+}
+
+void smartwin_latency_recorder::reset() {
+    for(int i = 0; i < SW_LATENCY_BUCKETS; i++) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+    min_us_.store(0xFFFFFFFF, std::memory_order_relaxed);
+    max_us_.store(0, std::memory_order_relaxed);
+    total_us_.store(0, std::memory_order_relaxed);
+}
+
+}
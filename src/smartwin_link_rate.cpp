@@ -0,0 +1,74 @@
+#include "smartwin_link_rate.h"
+#include "smartwin_time.h"
+#include <string.h>
+
+namespace smartwin {
+
+smartwin_link_rate::smartwin_link_rate() {
+    pthread_mutex_init(&mutex_, NULL);
+}
+
+smartwin_link_rate::~smartwin_link_rate() {
+    pthread_mutex_destroy(&mutex_);
+}
+
+void smartwin_link_rate::set_rates(const std::vector<uint32_t>& rates, uint32_t ok, uint32_t bad) {
+    pthread_mutex_lock(&mutex_);
+    rates_ = rates;
+    if(rates_.size() > SW_LINK_RATE_MAX) {
+        rates_.erase(rates_.begin(), rates_.end() - SW_LINK_RATE_MAX);
+    }
+    index_ = rates_.empty() ? 0 : rates_.size() - 1;
+    window_start_ms_ = smartwin_now_ms();
+    base_ok_ = ok;
+    base_bad_ = bad;
+    window_ok_ = 0;
+    window_bad_ = 0;
+    pthread_mutex_unlock(&mutex_);
+}
+
+uint32_t smartwin_link_rate::tick(uint64_t now_ms, uint32_t ok, uint32_t bad) {
+    uint32_t rate = 0;
+
+    pthread_mutex_lock(&mutex_);
+    if(index_ == 0 || window_start_ms_ == 0) {
+        // 已是最低一档或未探测
+        pthread_mutex_unlock(&mutex_);
+        return 0;
+    }
+
+    window_ok_ = ok - base_ok_;
+    window_bad_ = bad - base_bad_;
+    if(now_ms - window_start_ms_ >= WINDOW_MS) {
+        uint32_t total = window_ok_ + window_bad_;
+        if(window_bad_ >= MIN_BAD && window_bad_ * 100 > total * ERROR_PCT) {
+            index_--;
+            fallbacks_++;
+            rate = rates_[index_];
+        }
+        window_start_ms_ = now_ms;
+        base_ok_ = ok;
+        base_bad_ = bad;
+        window_ok_ = 0;
+        window_bad_ = 0;
+    }
+    pthread_mutex_unlock(&mutex_);
+    return rate;
+}
+
+void smartwin_link_rate::get_stats(smartwin_link_rate_stats& stats) {
+    memset(&stats, 0, sizeof(stats));
+
+    pthread_mutex_lock(&mutex_);
+    stats.baudrate = rates_.empty() ? 0 : rates_[index_];
+    stats.rate_count = (uint32_t)rates_.size();
+    for(size_t i = 0; i < rates_.size(); i++) {
+        stats.rates[i] = rates_[i];
+    }
+    stats.fallbacks = fallbacks_;
+    stats.window_ok = window_ok_;
+    stats.window_bad = window_bad_;
+    pthread_mutex_unlock(&mutex_);
+}
+
+}
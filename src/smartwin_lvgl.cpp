@@ -0,0 +1,96 @@
+#ifdef SMARTWIN_LVGL
+
+#include "smartwin_lvgl.h"
+#include "smartwin_devices.h"
+#include "smartwin_time.h"
+
+namespace smartwin {
+
+static smartwin_latency_recorder keypad_latency;
+static smartwin_latency_recorder pointer_latency;
+
+// 仅在LVGL线程访问
+static uint32_t keypad_last_key = 0;
+static bool keypad_pressed = false;
+
+static lv_point_t pointer_last = {0, 0};
+static lv_indev_state_t pointer_state = LV_INDEV_STATE_RELEASED;
+
+static uint32_t keypad_map(uint8_t code) {
+    switch(code) {
+    case KEY_CONFIRM:   return LV_KEY_ENTER;
+    case KEY_CANCEL:    return LV_KEY_ESC;
+    case KEY_BACKSPACE: return LV_KEY_BACKSPACE;
+    case KEY_CLEAR:     return LV_KEY_DEL;
+    case KEY_LEFT:      return LV_KEY_LEFT;
+    case KEY_RIGHT:     return LV_KEY_RIGHT;
+    case KEY_UP:        return LV_KEY_UP;
+    case KEY_DOWN:      return LV_KEY_DOWN;
+    case KEY_MENU:      return LV_KEY_HOME;
+    case KEY_FUNCTION:  return LV_KEY_NEXT;
+    default:            return code;    // 数字键和'*'与ASCII相同
+    }
+}
+
+void smartwin_lvgl_keypad_read(lv_indev_drv_t* drv, lv_indev_data_t* data) {
+    (void)drv;
+    smartwin_devices* dev = smartwin_devices::getInstance();
+
+    data->key = keypad_last_key;
+
+    // 上一个按键先报释放
+    if(keypad_pressed) {
+        keypad_pressed = false;
+        data->state = LV_INDEV_STATE_RELEASED;
+        data->continue_reading = true;
+        return;
+    }
+
+    uint8_t code = 0;
+    uint64_t timestamp_us = 0;
+    if(dev->keyboard_get_input(code, 0, &timestamp_us) != SDK_OK) {
+        data->state = LV_INDEV_STATE_RELEASED;
+        data->continue_reading = false;
+        return;
+    }
+
+    keypad_latency.record(timestamp_us, smartwin_now_us());
+
+    keypad_last_key = keypad_map(code);
+    keypad_pressed = true;
+    data->key = keypad_last_key;
+    data->state = LV_INDEV_STATE_PRESSED;
+    data->continue_reading = true;
+}
+
+void smartwin_lvgl_pointer_read(lv_indev_drv_t* drv, lv_indev_data_t* data) {
+    (void)drv;
+    smartwin_devices* dev = smartwin_devices::getInstance();
+
+    smartwin_touch_point pt;
+    if(dev->tp_drain_touch_events(&pt, 1) == 1) {
+        if(pt.action != SW_TOUCH_UP) {
+            pointer_latency.record(pt.timestamp_us, smartwin_now_us());
+        }
+
+        pointer_last.x = pt.x;
+        pointer_last.y = pt.y;
+        pointer_state = pt.action == SW_TOUCH_UP ? LV_INDEV_STATE_RELEASED : LV_INDEV_STATE_PRESSED;
+        data->continue_reading = true;
+    }
+    else {
+        data->continue_reading = false;
+    }
+
+    data->point = pointer_last;
+    data->state = pointer_state;
+}
+
+void smartwin_lvgl_get_stats(smartwin_latency_histogram& keypad, smartwin_latency_histogram& pointer) {
+    keypad_latency.snapshot(keypad);
+    pointer_latency.snapshot(pointer);
+}
+
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include "smartwin_presence.h"
+#include "smartwin_def.h"
+#include "smartwin_cmd.h"
+#include "smartwin_time.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace smartwin {
+
+smartwin_presence::smartwin_presence(std::function<int(uint8_t, std::vector<uint8_t>)> send,
+                                     std::function<bool()> busy,
+                                     std::function<void(const smartwin_event&)> emit) {
+    pthread_mutex_init(&mutex_, NULL);
+
+    enabled_ = 0;
+    in_flight_ = 0;
+    send_ = send;
+    busy_ = busy;
+    emit_ = emit;
+
+    mag_.cmd = CMD_CHECK_MAGNETIC_STRIPE_CARD;
+    mag_.state = STATE_UNKNOWN;
+    mag_.next_due_ms = 0;
+    ic_.cmd = CMD_CHECK_IC_STATUS;
+    ic_.state = STATE_UNKNOWN;
+    ic_.next_due_ms = 0;
+}
+
+smartwin_presence::~smartwin_presence() {
+    pthread_mutex_destroy(&mutex_);
+}
+
+void smartwin_presence::enable(uint8_t slots, uint8_t card_type, uint8_t card_seat) {
+    pthread_mutex_lock(&mutex_);
+    enabled_ = slots & (SW_PRESENCE_MAG | SW_PRESENCE_IC);
+    card_type_ = card_type;
+    card_seat_ = card_seat;
+    mag_.state = STATE_UNKNOWN;
+    ic_.state = STATE_UNKNOWN;
+    pthread_mutex_unlock(&mutex_);
+
+    boost();
+}
+
+void smartwin_presence::boost() {
+    uint64_t now = smartwin_now_ms();
+
+    pthread_mutex_lock(&mutex_);
+    interval_ms_ = FAST_INTERVAL_MS;
+    boost_until_ms_ = now + BOOST_WINDOW_MS;
+    mag_.next_due_ms = now;
+    ic_.next_due_ms = now;
+    pthread_mutex_unlock(&mutex_);
+}
+
+void smartwin_presence::tick() {
+    if(enabled_ == 0) {
+        return;
+    }
+
+    uint64_t now = smartwin_now_ms();
+
+    pthread_mutex_lock(&mutex_);
+    if(in_flight_ != 0) {
+        if(now < in_flight_deadline_ms_) {
+            pthread_mutex_unlock(&mutex_);
+            return;
+        }
+        printf("Err. presence check 0x%02X no response\n", in_flight_.load());
+        in_flight_ = 0;
+    }
+
+    // 两个对象都到期时交替发送, 避免一个对象饿死另一个
+    slot* first = ic_turn_ ? &ic_ : &mag_;
+    slot* second = ic_turn_ ? &mag_ : &ic_;
+    slot* s = nullptr;
+    for(slot* c : {first, second}) {
+        uint8_t bit = (c == &mag_) ? SW_PRESENCE_MAG : SW_PRESENCE_IC;
+        if((enabled_ & bit) && now >= c->next_due_ms) {
+            s = c;
+            break;
+        }
+    }
+
+    if(s == nullptr || (busy_ && busy_())) {
+        pthread_mutex_unlock(&mutex_);
+        return;
+    }
+
+    std::vector<uint8_t> params;
+    if(s == &ic_) {
+        params.push_back(card_type_);
+        params.push_back(card_seat_);
+    }
+
+    in_flight_ = s->cmd;
+    in_flight_deadline_ms_ = now + RESPONSE_TIMEOUT_MS;
+    ic_turn_ = (s == &mag_);
+
+    // 快速窗口结束后每次轮询间隔加倍, 直到慢速间隔
+    if(now >= boost_until_ms_ && interval_ms_ < SLOW_INTERVAL_MS) {
+        interval_ms_ = interval_ms_ * 2 > SLOW_INTERVAL_MS ? SLOW_INTERVAL_MS : interval_ms_ * 2;
+    }
+    s->next_due_ms = now + interval_ms_;
+    uint8_t cmd = s->cmd;
+    pthread_mutex_unlock(&mutex_);
+
+    send_(cmd, params);
+}
+
+void smartwin_presence::emit_edge(uint8_t type, uint8_t card_type, uint8_t card_seat) {
+    smartwin_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = type;
+    ev.timestamp_us = smartwin_now_us();
+    ev.presence.card_type = card_type;
+    ev.presence.card_seat = card_seat;
+    emit_(ev);
+}
+
+bool smartwin_presence::on_response(const std::vector<uint8_t>& buf) {
+    if(in_flight_ == 0 || buf.size() < 8 || buf[0] != in_flight_ || buf[1] != 0x4F) {
+        return false;
+    }
+
+    int code = buf[4];
+    code = (code<<8) + buf[5];
+    code = (code<<8) + buf[6];
+    code = (code<<8) + buf[7];
+
+    uint8_t edge = SW_EVENT_NONE;
+    uint8_t card_type = 0;
+    uint8_t card_seat = 0;
+
+    pthread_mutex_lock(&mutex_);
+    if(buf[0] != in_flight_) {
+        pthread_mutex_unlock(&mutex_);
+        return false;
+    }
+    in_flight_ = 0;
+
+    slot& s = (buf[0] == CMD_CHECK_MAGNETIC_STRIPE_CARD) ? mag_ : ic_;
+    int state = (code == SDK_OK) ? STATE_PRESENT : STATE_ABSENT;
+    if(state != s.state) {
+        if(&s == &mag_) {
+            edge = (state == STATE_PRESENT) ? SW_EVENT_MAG_SWIPE : SW_EVENT_NONE;
+        }
+        else if(state == STATE_PRESENT) {
+            edge = SW_EVENT_IC_INSERT;
+        }
+        else if(s.state == STATE_PRESENT) {
+            edge = SW_EVENT_IC_REMOVE;
+        }
+        s.state = state;
+    }
+
+    // 状态变化后通常还有后续操作(读磁道, 拔卡), 重新进入快速轮询
+    if(edge != SW_EVENT_NONE) {
+        uint64_t now = smartwin_now_ms();
+        interval_ms_ = FAST_INTERVAL_MS;
+        boost_until_ms_ = now + BOOST_WINDOW_MS;
+    }
+    card_type = card_type_;
+    card_seat = card_seat_;
+    pthread_mutex_unlock(&mutex_);
+
+    if(edge != SW_EVENT_NONE) {
+        emit_edge(edge, card_type, card_seat);
+    }
+    return true;
+}
+
+int smartwin_presence::get_timeout() {
+    if(enabled_ == 0) {
+        return -1;
+    }
+
+    uint64_t now = smartwin_now_ms();
+    uint64_t due = UINT64_MAX;
+
+    pthread_mutex_lock(&mutex_);
+    if(in_flight_ != 0) {
+        due = in_flight_deadline_ms_;
+    }
+    else {
+        if(enabled_ & SW_PRESENCE_MAG) {
+            due = mag_.next_due_ms;
+        }
+        if((enabled_ & SW_PRESENCE_IC) && ic_.next_due_ms < due) {
+            due = ic_.next_due_ms;
+        }
+    }
+    pthread_mutex_unlock(&mutex_);
+
+    return now >= due ? 0 : (int)(due - now);
+}
+
+}
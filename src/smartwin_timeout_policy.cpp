@@ -0,0 +1,144 @@
+#include "smartwin_timeout_policy.h"
+#include "smartwin_def.h"
+#include "smartwin_cmd.h"
+#include <string.h>
+#include <algorithm>
+
+namespace smartwin {
+
+// 默认超时表: 未列出的命令使用2000ms, 学习下限统一为50ms
+static const struct {
+    uint8_t cmd;
+    uint32_t default_ms;
+} default_timeouts[] = {
+    { CMD_SYSTEM_RESET,                             5000 },
+    { CMD_IC_CARD_RESET,                            3000 },
+    { CMD_IC_CARD_SEND_APDU_COMMAND,                5000 },
+    { CMD_ICC_SEARCH_CARD_ACTIVATION,               3000 },
+    { CMD_ICC_SEND_APDU_COMMAND,                    5000 },
+    { CMD_PRINT_BITMAP_DATA,                        5000 },
+    { CMD_PAPER_FEED,                               5000 },
+    { CMD_KEYPAD_GEN_RSA_KEY_PAIR_OUTPUT_PUBLIC_KEY, 15000 },
+    { CMD_KEYPAD_ENCRYPT_RSA_PRIVATE_KEY,           5000 },
+};
+
+// 处理时间随请求数据长度变化的命令: 小数据学到的超时对大数据过短
+static const uint8_t variable_cmds[] = {
+    CMD_IC_CARD_SEND_APDU_COMMAND, CMD_ICC_SEND_APDU_COMMAND, CMD_PRINT_BITMAP_DATA,
+    CMD_KEYPAD_ENCRYPT_DATA, CMD_KEYPAD_CALCULATE_MAC, CMD_KEYPAD_SM3_HASH,
+    CMD_KEYPAD_DES_ENCRYPT_DECRYPT, CMD_KEYPAD_AES_ENCRYPT_DECRYPT, CMD_KEYPAD_SM4_ENCRYPT_DECRYPT,
+    CMD_KEYPAD_SM2_ENCRYPT_DECRYPT, CMD_KEYPAD_SM2_SIGN, CMD_KEYPAD_SM2_VERIFY, CMD_FILE_DOWNLOAD,
+};
+
+static const uint32_t DEFAULT_TIMEOUT_MS = 2000;
+static const uint32_t DEFAULT_MIN_MS = 50;
+static const uint32_t DEFAULT_FACTOR = 3;
+
+smartwin_timeout_policy::smartwin_timeout_policy() {
+    pthread_mutex_init(&mutex_, NULL);
+
+    memset(entries_, 0, sizeof(entries_));
+    for(int i = 0; i < 256; i++) {
+        entries_[i].config.default_ms = DEFAULT_TIMEOUT_MS;
+        entries_[i].config.min_ms = DEFAULT_MIN_MS;
+        entries_[i].config.max_ms = DEFAULT_TIMEOUT_MS;
+        entries_[i].config.factor = DEFAULT_FACTOR;
+    }
+
+    for(auto& d : default_timeouts) {
+        entries_[d.cmd].config.default_ms = d.default_ms;
+        entries_[d.cmd].config.max_ms = d.default_ms;
+    }
+    for(auto cmd : variable_cmds) {
+        entries_[cmd].fixed = true;
+    }
+}
+
+smartwin_timeout_policy::~smartwin_timeout_policy() {
+    pthread_mutex_destroy(&mutex_);
+}
+
+void smartwin_timeout_policy::update(entry& e) {
+    uint32_t n = std::min(e.count, (uint32_t)SAMPLE_WINDOW);
+    if(n < MIN_SAMPLES) {
+        e.p99_us = 0;
+        e.learned_ms = 0;
+        return;
+    }
+
+    uint32_t tmp[SAMPLE_WINDOW];
+    memcpy(tmp, e.rtt_us, n * sizeof(uint32_t));
+    uint32_t k = (n * 99 + 99) / 100 - 1;
+    std::nth_element(tmp, tmp + k, tmp + n);
+    e.p99_us = tmp[k];
+
+    uint64_t ms = ((uint64_t)e.p99_us * e.config.factor + 999) / 1000;
+    ms = std::max(ms, (uint64_t)e.config.min_ms);
+    ms = std::min(ms, (uint64_t)e.config.max_ms);
+    e.learned_ms = (uint32_t)ms;
+}
+
+uint32_t smartwin_timeout_policy::current(const entry& e) {
+    return e.learned_ms > 0 ? e.learned_ms : e.config.default_ms;
+}
+
+int smartwin_timeout_policy::get_timeout(uint8_t cmd) {
+    pthread_mutex_lock(&mutex_);
+    int ms = current(entries_[cmd]);
+    pthread_mutex_unlock(&mutex_);
+    return ms;
+}
+
+void smartwin_timeout_policy::record(uint8_t cmd, uint32_t rtt_us) {
+    pthread_mutex_lock(&mutex_);
+    entry& e = entries_[cmd];
+    if(e.fixed) {
+        pthread_mutex_unlock(&mutex_);
+        return;
+    }
+    e.rtt_us[e.next] = rtt_us;
+    e.next = (e.next + 1) % SAMPLE_WINDOW;
+    e.count++;
+    update(e);
+    pthread_mutex_unlock(&mutex_);
+}
+
+void smartwin_timeout_policy::record_timeout(uint8_t cmd, uint32_t waited_ms) {
+    // 样本不足时仍使用默认值, 不记录, 避免链路断开时把默认超时拉长
+    pthread_mutex_lock(&mutex_);
+    bool learned = entries_[cmd].learned_ms > 0;
+    pthread_mutex_unlock(&mutex_);
+
+    if(learned) {
+        record(cmd, waited_ms * 1000);
+    }
+}
+
+int smartwin_timeout_policy::set_config(uint8_t cmd, const smartwin_timeout_config& config) {
+    if(config.min_ms == 0 || config.min_ms > config.max_ms || config.factor == 0
+        || config.default_ms == 0) {
+        return SDK_PARAMERR;
+    }
+
+    pthread_mutex_lock(&mutex_);
+    entry& e = entries_[cmd];
+    e.config = config;
+    e.count = 0;
+    e.next = 0;
+    update(e);
+    pthread_mutex_unlock(&mutex_);
+    return SDK_OK;
+}
+
+void smartwin_timeout_policy::get_info(uint8_t cmd, smartwin_timeout_info& info) {
+    pthread_mutex_lock(&mutex_);
+    const entry& e = entries_[cmd];
+    info.config = e.config;
+    info.samples = std::min(e.count, (uint32_t)SAMPLE_WINDOW);
+    info.p99_us = e.p99_us;
+    info.learned_ms = e.learned_ms;
+    info.timeout_ms = current(e);
+    pthread_mutex_unlock(&mutex_);
+}
+
+}
@@ -0,0 +1,100 @@
+#include "smartwin_touch_rate.h"
+#include "smartwin_time.h"
+
+namespace smartwin {
+
+smartwin_touch_rate::smartwin_touch_rate() {
+    enabled_ = false;
+    min_ms_ = 10;
+    idle_ms_ = 100;
+    last_point_us_ = 0;
+    drain_interval_ms_ = 0;
+    interval_ms_ = 0;
+    applying_ = false;
+    changes_ = 0;
+}
+
+void smartwin_touch_rate::enable(bool enable, uint32_t min_ms, uint32_t idle_ms) {
+    min_ms_ = min_ms > 0 ? min_ms : 1;
+    idle_ms_ = idle_ms > min_ms_ ? idle_ms : min_ms_.load();
+    enabled_ = enable;
+}
+
+void smartwin_touch_rate::note_point(uint64_t now_us) {
+    last_point_us_.store(now_us, std::memory_order_relaxed);
+}
+
+void smartwin_touch_rate::note_drain(uint64_t now_us, int count, bool emptied) {
+    // 只统计拖动中的读取, 空闲时应用的轮询频率不代表需求
+    uint64_t last_point = last_point_us_.load(std::memory_order_relaxed);
+    if(count <= 0 && now_us - last_point > (uint64_t)IDLE_AFTER_MS * 1000) {
+        last_frame_us_ = 0;
+        in_frame_ = false;
+        return;
+    }
+
+    // 同一帧内取空之前的连续读取不计间隔
+    if(!in_frame_) {
+        if(last_frame_us_ != 0) {
+            uint32_t dt = (uint32_t)((now_us - last_frame_us_) / 1000);
+            uint32_t avg = drain_interval_ms_.load(std::memory_order_relaxed);
+            avg = (avg == 0) ? dt : (avg * 7 + dt) / 8;
+            drain_interval_ms_.store(avg, std::memory_order_relaxed);
+        }
+        last_frame_us_ = now_us;
+        in_frame_ = true;
+    }
+    if(emptied) {
+        in_frame_ = false;
+    }
+}
+
+uint32_t smartwin_touch_rate::tick(uint64_t now_ms) {
+    if(!enabled_ || applying_ || now_ms - last_change_ms_ < HOLD_MS) {
+        return 0;
+    }
+
+    uint32_t target;
+    uint64_t last_point_ms = last_point_us_.load(std::memory_order_relaxed) / 1000;
+    if(last_point_ms == 0 || now_ms - last_point_ms > IDLE_AFTER_MS) {
+        target = idle_ms_;
+    }
+    else {
+        // 拖动中: 上报频率与应用读取频率一致即可, 更快的上报会在读取前被合并
+        uint32_t drain = drain_interval_ms_.load(std::memory_order_relaxed);
+        target = drain > 0 ? drain : min_ms_.load();
+        if(target < min_ms_) {
+            target = min_ms_;
+        }
+        if(target > idle_ms_) {
+            target = idle_ms_;
+        }
+    }
+
+    uint32_t cur = interval_ms_;
+    uint32_t diff = target > cur ? target - cur : cur - target;
+    if(cur != 0 && diff * 4 <= cur) {
+        return 0;
+    }
+
+    applying_ = true;
+    last_change_ms_ = now_ms;
+    return target;
+}
+
+void smartwin_touch_rate::applied(uint32_t interval_ms, bool ok) {
+    if(ok) {
+        interval_ms_ = interval_ms;
+        changes_++;
+    }
+    applying_ = false;
+}
+
+void smartwin_touch_rate::get_stats(smartwin_touch_rate_stats& stats) {
+    stats.enabled = enabled_ ? 1 : 0;
+    stats.interval_ms = interval_ms_;
+    stats.drain_interval_ms = drain_interval_ms_;
+    stats.changes = changes_;
+}
+
+}
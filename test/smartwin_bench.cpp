@@ -0,0 +1,586 @@
+#include "smartwin_devices.h"
+#include "smartwin_cmd.h"
+#include "smartwin_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// 输入延迟基准测试: 用pty模拟安全芯片的键盘和触摸屏, 按固定间隔主动上报,
+// 应用侧取出后打印库内各阶段的延迟直方图
+// 用法: smartwin_bench [按键数, 默认200] [上报间隔ms, 默认30] [低延迟模式 0/1, 默认0] [io_uring 0/1, 默认0]
+// 串口为pty, 波特率不限制实际速度, 下载吞吐反映的是库自身的开销上限
+// 库通过符号链接打开pty从端, 模拟器关闭主端并换一个新pty来模拟USB串口拔插和复位后重新枚举
+// export LD_LIBRARY_PATH=.:$LD_LIBRARY_PATH
+
+using namespace smartwin;
+
+static int master_fd = -1;
+static std::atomic<bool> sim_running(true);
+
+// 拔插模拟: 主线程请求, 模拟器线程执行, 主端只在模拟器线程中关闭和替换
+static std::string port_link;
+static std::atomic<bool> sim_mute(false);           // 只收不答, 制造在途请求
+static std::atomic<int> sim_replug_gap_ms(-1);      // >=0: 断开该时长后换新pty
+static std::atomic<int> sim_replug_delay_ms(0);     // 断开前的延迟
+static std::atomic<int> sim_replugs(0);
+static std::atomic<uint64_t> sim_unplug_us(0);      // 最近一次关闭主端的时间
+static const int reset_delay_ms = 50;               // system_reset应答后到断开的时间
+static const int reset_gap_ms = 200;                // system_reset后重新枚举的时间
+
+static int key_count = 200;
+static int interval_ms = 30;
+static int touch_count = 200;
+static int low_latency = 0;
+static int io_uring = 0;
+static int round_trips = 100;
+
+// 模拟器写入每个按键/触摸帧的时间, 用于统计包含轮询等待的端到端延迟
+static std::vector<uint64_t> key_write_us;
+static std::vector<uint64_t> touch_write_us;
+static std::atomic<int> keys_sent(0);
+static std::atomic<int> touches_sent(0);
+static std::atomic<bool> key_phase(false);
+static std::atomic<bool> touch_phase(false);
+
+static void sim_write_frame(std::vector<uint8_t> payload) {
+    std::vector<uint8_t> frame;
+    uint8_t x = 0;
+    frame.push_back(0x02);
+    for(size_t i = 0; i < payload.size(); i++) {
+        frame.push_back(payload[i]);
+        x ^= payload[i];
+    }
+    frame.push_back(0x03);
+    frame.push_back(x);
+
+    if(write(master_fd, frame.data(), frame.size()) != (ssize_t)frame.size()) {
+        printf("sim write error\n");
+    }
+}
+
+// 对收到的每条命令回一个成功应答
+static void sim_handle_input(std::vector<uint8_t>& in) {
+    while(in.size() >= 7) {
+        if(in[0] != 0x02) {
+            in.erase(in.begin());
+            continue;
+        }
+        size_t ln = in[3] * 256 + in[4];
+        if(in.size() < ln + 7) {
+            return;
+        }
+        if(!sim_mute) {
+            sim_write_frame({in[1], 0x4F, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00});
+        }
+        if(in[1] == CMD_SYSTEM_RESET) {
+            sim_replug_delay_ms = reset_delay_ms;
+            sim_replug_gap_ms = reset_gap_ms;
+        }
+        in.erase(in.begin(), in.begin() + ln + 7);
+    }
+}
+
+static int sim_open_port() {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        return -1;
+    }
+    std::string tmp = port_link + ".new";
+    unlink(tmp.c_str());
+    if(symlink(ptsname(fd), tmp.c_str()) != 0 || rename(tmp.c_str(), port_link.c_str()) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 延迟delay_ms后设备消失, gap_ms后以新的pty出现, 从端收到挂断
+static void sim_replug(int delay_ms, int gap_ms, std::vector<uint8_t>& in) {
+    usleep(delay_ms * 1000);
+    unlink(port_link.c_str());
+    close(master_fd);
+    sim_unplug_us = smartwin_now_us();
+    in.clear();
+    usleep(gap_ms * 1000);
+    master_fd = sim_open_port();
+    if(master_fd < 0) {
+        printf("ERROR: replug failed\n");
+    }
+    sim_mute = false;
+    sim_replugs++;
+}
+
+static void* sim_thread_func(void*) {
+    std::vector<uint8_t> in;
+    uint64_t next_us = smartwin_now_us() + 200 * 1000;
+
+    while(sim_running) {
+        struct pollfd pfd;
+        pfd.fd = master_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        uint64_t now = smartwin_now_us();
+        int wait = now >= next_us ? 0 : (int)((next_us - now + 999) / 1000);
+        if(poll(&pfd, 1, wait) > 0 && (pfd.revents & POLLIN)) {
+            uint8_t buf[256];
+            ssize_t n = read(master_fd, buf, sizeof(buf));
+            if(n > 0) {
+                in.insert(in.end(), buf, buf + n);
+                sim_handle_input(in);
+            }
+        }
+
+        int gap = sim_replug_gap_ms.exchange(-1);
+        if(gap >= 0) {
+            sim_replug(sim_replug_delay_ms.exchange(0), gap, in);
+        }
+
+        now = smartwin_now_us();
+        if(now < next_us) {
+            continue;
+        }
+        next_us = now + interval_ms * 1000;
+
+        int k = keys_sent;
+        if(key_phase && k < key_count) {
+            uint8_t code = KEY_0 + k % 10;
+            key_write_us[k] = smartwin_now_us();
+            sim_write_frame({CMD_READ_KEYBOARD_INPUT, 0x4F, 0x00, 0x04, 0x00, 0x00, 0x00, code});
+            keys_sent++;
+            continue;
+        }
+
+        int t = touches_sent;
+        if(touch_phase && t < touch_count) {
+            // 从左到右拖动, 坐标原点在左下角
+            uint16_t x = (uint16_t)(t * 319 / touch_count);
+            uint16_t y = 120;
+            touch_write_us[t] = smartwin_now_us();
+            sim_write_frame({CMD_GET_TOUCH_COORDINATE, 0x4F, 0x00, 0x04,
+                (uint8_t)(x >> 8), (uint8_t)x, (uint8_t)(y >> 8), (uint8_t)y});
+            touches_sent++;
+        }
+    }
+    return nullptr;
+}
+
+static void print_hist(const char* name, const smartwin_latency_histogram& hist) {
+    if(hist.count == 0) {
+        printf("%-22s no samples\n", name);
+        return;
+    }
+    printf("%-22s n=%-5u min=%-6u avg=%-6llu p50<=%-6u p99<=%-6u max=%u us\n", name,
+        hist.count, hist.min_us, (unsigned long long)(hist.total_us / hist.count),
+        hist.p50_us, hist.p99_us, hist.max_us);
+
+    for(int i = 0; i < SW_LATENCY_BUCKETS; i++) {
+        if(hist.buckets[i] == 0) {
+            continue;
+        }
+        int bar = (int)((uint64_t)hist.buckets[i] * 40 / hist.count);
+        printf("    %8u-%-8u us %5u ", i == 0 ? 0 : (1U << i), (2U << i) - 1, hist.buckets[i]);
+        for(int j = 0; j < bar; j++) {
+            printf("#");
+        }
+        printf("\n");
+    }
+}
+
+static void print_source(const char* title, uint8_t source, smartwin_latency_recorder& e2e) {
+    smartwin_devices* dev = smartwin_devices::getInstance();
+    smartwin_latency_histogram hist;
+
+    printf("\n==== %s ====\n", title);
+    dev->get_input_latency(source, SW_LATENCY_WIRE, hist);
+    print_hist("first byte -> frame", hist);
+    dev->get_input_latency(source, SW_LATENCY_QUEUE, hist);
+    print_hist("frame -> dequeue", hist);
+    dev->get_input_latency(source, SW_LATENCY_TOTAL, hist);
+    print_hist("first byte -> dequeue", hist);
+    e2e.snapshot(hist);
+    print_hist("sim write -> dequeue", hist);
+}
+
+// 断开重连: 在途请求的失败/重发时间, 以及system_reset后重新枚举到第一条命令成功的时间
+struct inflight_call {
+    int cmd;
+    int ret;
+    uint64_t done_us;
+};
+
+static void* inflight_func(void* arg) {
+    inflight_call* call = (inflight_call*)arg;
+    smartwin_devices* dev = smartwin_devices::getInstance();
+    call->ret = call->cmd == CMD_BEEP ? dev->beep(0) : dev->led_on(0);
+    call->done_us = smartwin_now_us();
+    return nullptr;
+}
+
+static void sim_wait_replug(int count) {
+    while(sim_replugs < count) {
+        usleep(1000);
+    }
+}
+
+static void bench_reconnect() {
+    const int loops = 5;
+    const int unplug_gap_ms = 100;
+    smartwin_devices* dev = smartwin_devices::getInstance();
+
+    smartwin_latency_recorder lost_fail;
+    smartwin_latency_recorder lost_replay;
+    smartwin_latency_recorder reset_recover;
+    int fail_ret = SDK_OK;
+    int replay_ret = SDK_OK;
+    int replay_ok = 0;
+
+    for(int i = 0; i < loops; i++) {
+        // 模拟器不应答, beep(不可重发)和led_on(幂等, 重发)在途时拔出
+        sim_mute = true;
+        inflight_call beep_call = { CMD_BEEP, SDK_OK, 0 };
+        inflight_call led_call = { CMD_LED_ON, SDK_OK, 0 };
+        pthread_t t1, t2;
+        pthread_create(&t1, NULL, inflight_func, &beep_call);
+        pthread_create(&t2, NULL, inflight_func, &led_call);
+        usleep(20 * 1000);
+
+        int replugs = sim_replugs;
+        sim_replug_gap_ms = unplug_gap_ms;
+        pthread_join(t1, NULL);
+        pthread_join(t2, NULL);
+        sim_wait_replug(replugs + 1);
+        while(!dev->link_is_up()) {
+            usleep(1000);
+        }
+
+        uint64_t unplug_us = sim_unplug_us;
+        fail_ret = beep_call.ret;
+        lost_fail.record(unplug_us, beep_call.done_us);
+        replay_ret = led_call.ret;
+        if(led_call.ret == SDK_OK) {
+            replay_ok++;
+            lost_replay.record(unplug_us, led_call.done_us);
+        }
+
+        // system_reset应答后设备重新枚举, 轮询到第一条命令成功
+        replugs = sim_replugs;
+        uint64_t reset_us = smartwin_now_us();
+        if(dev->system_reset() != SDK_OK) {
+            printf("ERROR: system_reset failed\n");
+        }
+        uint64_t deadline = smartwin_now_ms() + 5000;
+        while(smartwin_now_ms() < deadline) {
+            if(sim_replugs > replugs && dev->led_on(0) == SDK_OK) {
+                reset_recover.record(reset_us, smartwin_now_us());
+                break;
+            }
+            usleep(1000);
+        }
+    }
+
+    smartwin_latency_histogram hist;
+    printf("\n==== reconnect (unplug %d ms, reset %d ms) ====\n", unplug_gap_ms, reset_gap_ms);
+    lost_fail.snapshot(hist);
+    print_hist("unplug -> beep fails", hist);
+    printf("beep ret: %d\n", fail_ret);
+    lost_replay.snapshot(hist);
+    print_hist("unplug -> led replayed", hist);
+    printf("led_on replayed ok: %d/%d, last ret: %d\n", replay_ok, loops, replay_ret);
+    reset_recover.snapshot(hist);
+    print_hist("reset -> first ok", hist);
+}
+
+// 串口层超时/断开路径: 抛异常接口与error_code接口的单次调用开销
+static void bench_error_path() {
+    const int loops = 1000;
+
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        printf("ERROR: open pty failed\n");
+        return;
+    }
+    serial::Serial port(ptsname(fd), 460800, serial::Timeout::simpleTimeout(0));
+
+    smartwin_latency_recorder timeout_throw;
+    smartwin_latency_recorder timeout_ec;
+    smartwin_latency_recorder disconnect_throw;
+    smartwin_latency_recorder disconnect_ec;
+    uint8_t buf[1];
+    std::error_code ec;
+
+    // 超时: 端口空闲, 读不到数据
+    for(int i = 0; i < loops; i++) {
+        uint64_t start = smartwin_now_us();
+        port.read(buf, 1);
+        timeout_throw.record(start, smartwin_now_us());
+
+        start = smartwin_now_us();
+        port.read(buf, 1, ec);
+        timeout_ec.record(start, smartwin_now_us());
+    }
+
+    // 断开: 关闭pty主端后从端一直可读但读返回错误, 超时不为0才会走到读取
+    serial::Timeout to = serial::Timeout::simpleTimeout(10);
+    port.setTimeout(to);
+    close(fd);
+    for(int i = 0; i < loops; i++) {
+        uint64_t start = smartwin_now_us();
+        try
+        {
+            port.read(buf, 1);
+        }
+        catch(std::exception &e)
+        {
+        }
+        disconnect_throw.record(start, smartwin_now_us());
+
+        start = smartwin_now_us();
+        port.read(buf, 1, ec);
+        disconnect_ec.record(start, smartwin_now_us());
+    }
+    printf("disconnect error: %s\n", ec.message().c_str());
+
+    smartwin_latency_histogram hist;
+    printf("\n==== serial error path ====\n");
+    timeout_throw.snapshot(hist);
+    print_hist("timeout (exception)", hist);
+    timeout_ec.snapshot(hist);
+    print_hist("timeout (error_code)", hist);
+    disconnect_throw.snapshot(hist);
+    print_hist("disconnect (exception)", hist);
+    disconnect_ec.snapshot(hist);
+    print_hist("disconnect (error_code)", hist);
+}
+
+// 按460800波特率的速度从pty主端取走数据, 模拟线路发送
+static std::atomic<bool> drain_running(false);
+
+static void* line_drain_func(void* arg) {
+    int fd = *(int*)arg;
+    uint8_t buf[460];
+    while(drain_running) {
+        if(read(fd, buf, sizeof(buf)) < 0) {
+            usleep(1000);
+        }
+        usleep(10 * 1000);
+    }
+    return nullptr;
+}
+
+// 4K数据包: 阻塞写与写队列的调用返回时间, 以及写队列排空时间
+static void bench_write_path() {
+    const int loops = 20;
+    const size_t size = 4096;
+
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        printf("ERROR: open pty failed\n");
+        return;
+    }
+    serial::Serial port(ptsname(fd), 460800, serial::Timeout::simpleTimeout(1000));
+    port.setIoUring(io_uring != 0);
+
+    drain_running = true;
+    pthread_t drain_thread;
+    pthread_create(&drain_thread, NULL, line_drain_func, &fd);
+
+    std::vector<uint8_t> data(size, 0x55);
+    smartwin_latency_recorder sync_call;
+    smartwin_latency_recorder async_call;
+    smartwin_latency_recorder async_done;
+    std::error_code ec;
+
+    for(int i = 0; i < loops; i++) {
+        uint64_t start = smartwin_now_us();
+        port.write(data.data(), size, ec);
+        sync_call.record(start, smartwin_now_us());
+        port.waitWriteComplete(1000, ec);
+
+        start = smartwin_now_us();
+        port.writeAsync(data.data(), size, ec);
+        async_call.record(start, smartwin_now_us());
+        port.waitWriteComplete(1000, ec);
+        async_done.record(start, smartwin_now_us());
+    }
+    if(ec) {
+        printf("write error: %s\n", ec.message().c_str());
+    }
+
+    drain_running = false;
+    pthread_join(drain_thread, NULL);
+    port.close();
+    close(fd);
+
+    smartwin_latency_histogram hist;
+    printf("\n==== 4K write ====\n");
+    sync_call.snapshot(hist);
+    print_hist("write (blocking)", hist);
+    async_call.snapshot(hist);
+    print_hist("writeAsync", hist);
+    async_done.snapshot(hist);
+    print_hist("writeAsync -> drained", hist);
+}
+
+int main(int argc, char* argv[]) {
+    if(argc > 1) {
+        key_count = atoi(argv[1]);
+    }
+    if(argc > 2) {
+        interval_ms = atoi(argv[2]);
+    }
+    if(argc > 3) {
+        low_latency = atoi(argv[3]);
+    }
+    if(argc > 4) {
+        io_uring = atoi(argv[4]);
+    }
+    if(key_count <= 0 || interval_ms <= 0) {
+        printf("usage: %s [keys] [interval_ms] [low_latency] [io_uring]\n", argv[0]);
+        return -1;
+    }
+    touch_count = key_count;
+    key_write_us.resize(key_count);
+    touch_write_us.resize(touch_count);
+
+    port_link = "/tmp/smartwin_bench_tty." + std::to_string(getpid());
+    master_fd = sim_open_port();
+    if(master_fd < 0) {
+        printf("ERROR: open pty failed\n");
+        return -1;
+    }
+    printf("simulated device: %s -> %s\n", port_link.c_str(), ptsname(master_fd));
+
+    smartwin_devices::set_port(port_link, 460800);
+    smartwin_devices::set_link_replay(true);
+    // pty不区分波特率, 模拟器相当于支持自动波特率的设备
+    smartwin_devices::set_autobaud(true);
+    smartwin_devices::set_low_latency_mode(low_latency != 0);
+    smartwin_devices::set_io_uring_mode(io_uring != 0);
+    smartwin_devices* dev = smartwin_devices::getInstance();
+
+    pthread_t sim_thread;
+    pthread_create(&sim_thread, NULL, sim_thread_func, NULL);
+    int ret = SDK_OK;
+
+    // 短帧命令往返: 模拟器对每条命令立即应答
+    smartwin_latency_recorder beep_rtt;
+    smartwin_latency_recorder led_rtt;
+    // 往返期间整个进程(库线程+模拟器)的上下文切换次数
+    struct rusage ru_start, ru_end;
+    getrusage(RUSAGE_SELF, &ru_start);
+    for(int i = 0; i < round_trips; i++) {
+        uint64_t start = smartwin_now_us();
+        if(dev->beep(0) == SDK_OK) {
+            beep_rtt.record(start, smartwin_now_us());
+        }
+        start = smartwin_now_us();
+        if(dev->led_on(0) == SDK_OK) {
+            led_rtt.record(start, smartwin_now_us());
+        }
+    }
+    getrusage(RUSAGE_SELF, &ru_end);
+    long vcsw = ru_end.ru_nvcsw - ru_start.ru_nvcsw;
+    long ivcsw = ru_end.ru_nivcsw - ru_start.ru_nivcsw;
+
+    // 波特率探测, pty不限速, 各档都会通过
+    const uint32_t rates[] = {921600, 1500000, 3000000};
+    uint32_t baudrate = 0;
+    ret = dev->link_probe_baudrate(rates, 3, baudrate);
+    smartwin_link_rate_stats link;
+    dev->get_link_rate_stats(link);
+    printf("link probe ret: %d, baudrate: %u, verified:", ret, baudrate);
+    for(uint32_t i = 0; i < link.rate_count; i++) {
+        printf(" %u", link.rates[i]);
+    }
+    printf("\n");
+
+    // 下载吞吐: 4000字节一包, 等待应答后发下一包
+    const int packets = 32;
+    std::vector<uint8_t> block(4000, 0xA5);
+    uint64_t start = smartwin_now_us();
+    int sent = 0;
+    for(int i = 0; i < packets; i++) {
+        if(dev->file_download((uint8_t)i, (uint32_t)(i * block.size()), block) != SDK_OK) {
+            printf("ERROR: file_download %d failed\n", i);
+            break;
+        }
+        sent++;
+    }
+    uint64_t cost = smartwin_now_us() - start;
+    uint64_t download_bps = cost > 0 ? (uint64_t)sent * block.size() * 1000000 / cost : 0;
+
+    // 按键: 逐个阻塞读取
+    key_phase = true;
+    smartwin_latency_recorder key_e2e;
+    for(int i = 0; i < key_count; i++) {
+        uint8_t key = 0;
+        if(dev->keyboard_get_input(key, 1000, nullptr) != SDK_OK) {
+            printf("ERROR: key %d timeout\n", i);
+            break;
+        }
+        key_e2e.record(key_write_us[i], smartwin_now_us());
+    }
+
+    // 触摸: 按16ms一帧批量取出, 模拟UI刷新
+    smartwin_latency_recorder touch_e2e;
+    ret = dev->tp_open();
+    if(ret != SDK_OK) {
+        printf("ERROR: tp_open ret: %d\n", ret);
+    }
+    touch_phase = true;
+
+    int received = 0;
+    uint64_t deadline = smartwin_now_ms() + (uint64_t)touch_count * interval_ms + 2000;
+    while(received < touch_count && smartwin_now_ms() < deadline) {
+        smartwin_touch_point points[32];
+        int n = dev->tp_drain_touch_events(points, 32);
+        uint64_t now = smartwin_now_us();
+        for(int i = 0; i < n; i++) {
+            if(points[i].rx_start_us == 0) {
+                continue;       // 库补的抬起点
+            }
+            touch_e2e.record(touch_write_us[received], now);
+            received++;
+        }
+        usleep(16 * 1000);
+    }
+
+    key_phase = false;
+    touch_phase = false;
+    bench_reconnect();
+
+    sim_running = false;
+    pthread_join(sim_thread, NULL);
+    unlink(port_link.c_str());
+
+    printf("\nkeys: %d, touch points: %d, interval: %d ms, low latency: %d, io_uring: %d\n",
+        key_count, received, interval_ms, low_latency, dev->get_io_uring() ? 1 : 0);
+
+    smartwin_latency_histogram hist;
+    printf("\n==== round trip ====\n");
+    beep_rtt.snapshot(hist);
+    print_hist("beep", hist);
+    led_rtt.snapshot(hist);
+    print_hist("led_on", hist);
+    printf("context switches per round trip: %.1f voluntary, %.1f involuntary\n",
+        (double)vcsw / (round_trips * 2), (double)ivcsw / (round_trips * 2));
+    printf("file_download: %d x %u bytes, %llu bytes/s at %u baud\n", sent,
+        (unsigned)block.size(), (unsigned long long)download_bps, baudrate);
+    print_source("key", SW_LATENCY_KEY, key_e2e);
+    print_source("touch", SW_LATENCY_TOUCH, touch_e2e);
+
+    bench_error_path();
+    bench_write_path();
+
+    // 不关闭master_fd: 进程退出前接收线程仍在读从端
+    return 0;
+}
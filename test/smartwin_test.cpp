@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <vector>
+#include <sys/epoll.h>
 
 // export LD_LIBRARY_PATH=.:$LD_LIBRARY_PATH
 smartwin::smartwin_devices* _devices = smartwin::smartwin_devices::getInstance();
@@ -352,6 +353,20 @@ void test_tp()
     }
     printf("tp_get_touch_coordinate end\n");
 
+    smartwin::smartwin_touch_point points[32];
+    cnt = 100;
+    printf("tp_drain_touch_events start, get 100 points\n");
+    while (cnt > 0) {
+        int n = _devices->tp_drain_touch_events(points, 32);
+        for (int i = 0; i < n; i++) {
+            printf("tp_drain_touch_events action: %d, x: %d, y: %d, ts: %llu us\n", points[i].action,
+                points[i].x, points[i].y, (unsigned long long)points[i].timestamp_us);
+        }
+        cnt -= n;
+        usleep(10 * 1000);
+    }
+    printf("tp_drain_touch_events end\n");
+
     ret = _devices->tp_close();
     if (ret != 0) {
         printf("ERROR: tp_close ret: %d\n", ret);
@@ -590,18 +605,15 @@ void test_search_card()
         return;
     }
     printf("search_card_start ret: %d\n", ret);
-    int cnt = 10;
-    while (cnt > 0) {
-        uint8_t type = 0;
-        uint8_t key = 0;
-        ret = _devices->search_card_get_status(type, key);
-        if (ret == 0) {
-            printf("search_card_get_status ret: %d, type: %d, key: %d\n", ret, type, key);
-            break;
-        }
-        sleep(1);
-        cnt--;
-    }
+
+    uint8_t type = 0;
+    uint8_t key = 0;
+    ret = _devices->search_card_wait(10000, type, key);
+    printf("search_card_wait ret: %d, type: %d, key: %d\n", ret, type, key);
+
+    smartwin::smartwin_latency_histogram hist;
+    _devices->get_search_card_stats(hist);
+    printf("search_card wake latency: count %u, p99 <= %u us, max %u us\n", hist.count, hist.p99_us, hist.max_us);
     
     ret = _devices->search_card_stop();
     if (ret != 0) {
@@ -724,6 +736,64 @@ void test_keypad()
     printf("keypad_close ret: %d\n", ret);
 }
 
+void test_event()
+{
+    int ret = _devices->keyboard_open();
+    if (ret != 0) {
+        printf("ERROR: keyboard_open ret: %d\n", ret);
+        return;
+    }
+    ret = _devices->tp_open();
+    if (ret != 0) {
+        printf("ERROR: tp_open ret: %d\n", ret);
+    }
+
+    int efd = epoll_create1(0);
+    struct epoll_event ee;
+    ee.events = EPOLLIN;
+    ee.data.fd = _devices->event_get_fd();
+    epoll_ctl(efd, EPOLL_CTL_ADD, ee.data.fd, &ee);
+
+    _devices->magnetic_stripe_card_open();
+    _devices->ic_card_open(SDK_CARD_TYPE_CPU, SDK_CARD_SEAT_STANDARD);
+    _devices->presence_enable(SW_PRESENCE_MAG | SW_PRESENCE_IC, SDK_CARD_TYPE_CPU, SDK_CARD_SEAT_STANDARD);
+
+    int cnt = 20;
+    printf("event wait start, get 20 events\n");
+    while (cnt > 0) {
+        struct epoll_event out;
+        if (epoll_wait(efd, &out, 1, 10000) <= 0) {
+            printf("ERROR: epoll_wait timeout\n");
+            break;
+        }
+
+        std::vector<smartwin::smartwin_event> events;
+        _devices->event_drain(events);
+        for (auto &ev : events) {
+            if (ev.type == SW_EVENT_KEY) {
+                printf("event key: %d\n", ev.key.code);
+            } else if (ev.type == SW_EVENT_TOUCH) {
+                printf("event touch x: %d, y: %d\n", ev.touch.x, ev.touch.y);
+            } else if (ev.type == SW_EVENT_MAG_SWIPE) {
+                printf("event magnetic stripe card swiped\n");
+                _devices->magnetic_stripe_card_clear_data();
+            } else if (ev.type == SW_EVENT_IC_INSERT || ev.type == SW_EVENT_IC_REMOVE) {
+                printf("event ic card %s\n", ev.type == SW_EVENT_IC_INSERT ? "inserted" : "removed");
+            } else {
+                printf("event type: %d\n", ev.type);
+            }
+            cnt--;
+        }
+    }
+    close(efd);
+
+    _devices->presence_enable(0);
+    _devices->ic_card_close(SDK_CARD_TYPE_CPU, SDK_CARD_SEAT_STANDARD);
+    _devices->magnetic_stripe_card_close();
+    _devices->tp_close();
+    _devices->keyboard_close();
+}
+
 
 int main()
 {
@@ -739,9 +809,10 @@ int main()
         printf("| 7. test_mifare_card               8. test_search_card\n");
         printf("| 9. test_scan                     10. test_printer\n");
         printf("|11. test_keypad                   12. test_tp\n");
+        printf("|13. test_event\n");
         printf("+---------------------------------------------------+\n");
 
-        printf("请输入测试项[0-11]: ");
+        printf("请输入测试项[0-13]: ");
         scanf("%d", &choice);
 
         switch (choice)
@@ -790,6 +861,9 @@ int main()
             case 12:
                 test_tp();
                 break;
+            case 13:
+                test_event();
+                break;
             case 0:
                 return 0;
         }     